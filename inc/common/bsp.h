@@ -129,7 +129,6 @@ typedef struct {
     int                 contents;
     int                 numsides;
     mbrushside_t        *firstbrushside;
-    int                 checkcount;        // to avoid repeated testings
 } mbrush_t;
 
 typedef struct {
@@ -221,6 +220,7 @@ typedef struct bsp_s {
     int             numvisibility;
     int             visrowsize;
     dvis_t          *vis;
+    byte            *visrows;   // decompressed PVS/PHS rows, if cached
 
     int             numentitychars;
     char            *entitystring;
@@ -273,6 +273,7 @@ void BSP_TransformedLightPoint(lightpoint_t *point, vec3_t start, vec3_t end,
 #endif
 
 byte *BSP_ClusterVis(bsp_t *bsp, byte *mask, int cluster, int vis);
+const byte *BSP_GetClusterVis(bsp_t *bsp, byte *mask, int cluster, int vis);
 mleaf_t *BSP_PointLeaf(mnode_t *node, vec3_t p);
 mmodel_t *BSP_InlineModel(bsp_t *bsp, const char *name);
 
@@ -32,6 +32,24 @@ typedef struct {
     bool        *portalopen;
 } cm_t;
 
+// per-thread tracing state, allows tracing from multiple threads.
+// must be zero initialized before first use and may be reused afterwards.
+#define CM_TRACE_BRUSHES_BITS   8
+#define CM_TRACE_BRUSHES        (1 << CM_TRACE_BRUSHES_BITS)
+#define CM_TRACE_CHECKED        (CM_TRACE_BRUSHES * 3 / 4)
+
+typedef struct {
+    trace_t     *trace;
+    vec3_t      start, end;
+    vec3_t      offsets[8];
+    vec3_t      extents;
+    int         contents;
+    bool        ispoint;        // optimized case
+    int         numchecked;
+    byte        checkedslots[CM_TRACE_CHECKED]; // used hash set slots
+    mbrush_t    *checked[CM_TRACE_BRUSHES];     // visited brushes hash set
+} cm_trace_t;
+
 void        CM_Init(void);
 
 void        CM_FreeMap(cm_t *cm);
@@ -63,6 +81,19 @@ void        CM_TransformedBoxTrace(trace_t *trace, vec3_t start, vec3_t end,
                                    vec3_t mins, vec3_t maxs,
                                    mnode_t * headnode, int brushmask,
                                    vec3_t origin, vec3_t angles);
+
+// reentrant versions of the above, box hull returned by
+// CM_HeadnodeForBox is still shared and must not be used concurrently
+void        CM_BoxTraceCtx(cm_trace_t *ctx, trace_t *trace,
+                           vec3_t start, vec3_t end,
+                           vec3_t mins, vec3_t maxs,
+                           mnode_t *headnode, int brushmask);
+void        CM_TransformedBoxTraceCtx(cm_trace_t *ctx, trace_t *trace,
+                                      vec3_t start, vec3_t end,
+                                      vec3_t mins, vec3_t maxs,
+                                      mnode_t * headnode, int brushmask,
+                                      vec3_t origin, vec3_t angles);
+
 void        CM_ClipEntity(trace_t *dst, const trace_t *src, struct edict_s *ent);
 
 // call with topnode set to the headnode, returns with topnode
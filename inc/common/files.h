@@ -69,11 +69,12 @@ typedef struct file_info_s {
 #define FS_SEARCH_DIRSONLY      0x00001000
 #define FS_SEARCH_MASK          0x00001f00
 
-// bits 8 - 11, flag
+// bits 8 - 12, flag
 #define FS_FLAG_GZIP            0x00000100
 #define FS_FLAG_EXCL            0x00000200
 #define FS_FLAG_TEXT            0x00000400
 #define FS_FLAG_DEFLATE         0x00000800
+#define FS_FLAG_MAPPED          0x00001000  // FS_LoadFile may return read-only view
 
 //
 // Limit the maximum file size FS_LoadFile can handle, as a protection from
@@ -89,7 +90,6 @@ typedef struct file_info_s {
 #define FS_Mallocz(size)        Z_TagMallocz(size, TAG_FILESYSTEM)
 #define FS_CopyString(string)   Z_TagCopyString(string, TAG_FILESYSTEM)
 #define FS_LoadFile(path, buf)  FS_LoadFileEx(path, buf, 0, TAG_FILESYSTEM)
-#define FS_FreeFile(buf)        Z_Free(buf)
 
 // just regular malloc for now
 #define FS_AllocTempMem(size)   FS_Malloc(size)
@@ -105,6 +105,8 @@ typedef struct file_info_s {
 void    FS_Init(void);
 void    FS_Shutdown(void);
 void    FS_Restart(bool total);
+void    FS_FlushIndex(void);
+void    FS_FileCreated(const char *path);
 
 #if USE_CLIENT
 int FS_RenameFile(const char *from, const char *to);
@@ -116,6 +118,7 @@ char    *FS_CopyExtraInfo(const char *name, const file_info_t *info);
 
 int64_t FS_FOpenFile(const char *filename, qhandle_t *f, unsigned mode);
 int     FS_FCloseFile(qhandle_t f);
+int64_t FS_OpenDetached(const char *name, FILE **fp);
 qhandle_t FS_EasyOpenFile(char *buf, size_t size, unsigned mode,
                           const char *dir, const char *name, const char *ext);
 
@@ -127,6 +130,7 @@ qhandle_t FS_EasyOpenFile(char *buf, size_t size, unsigned mode,
 int FS_LoadFileEx(const char *path, void **buffer, unsigned flags, memtag_t tag);
 // a NULL buffer will just return the file length without loading
 // length < 0 indicates error
+void FS_FreeFile(void *buf);
 
 int FS_WriteFile(const char *path, const void *data, size_t len);
 
@@ -79,7 +79,31 @@ typedef enum {
     MSG_ES_REMOVE       = (1 << 7)
 } msgEsFlags_t;
 
-extern sizebuf_t    msg_write;
+typedef struct {
+    int type;
+    vec3_t pos1;
+    vec3_t pos2;
+    vec3_t offset;
+    vec3_t dir;
+    int count;
+    int color;
+    int entity1;
+    int entity2;
+    int time;
+} tent_params_t;
+
+typedef struct {
+    int     flags;
+    int     index;
+    int     entity;
+    int     channel;
+    vec3_t  pos;
+    float   volume;
+    float   attenuation;
+    float   timeofs;
+} snd_params_t;
+
+extern q_threadlocal sizebuf_t  msg_write;
 extern byte         msg_write_buffer[MAX_MSGLEN];
 
 extern sizebuf_t    msg_read;
@@ -99,7 +123,7 @@ void    MSG_WriteLong(int c);
 void    MSG_WriteString(const char *s);
 void    MSG_WritePos(const vec3_t pos);
 void    MSG_WriteAngle(float f);
-#if USE_CLIENT
+#if USE_CLIENT || USE_LOADGEN
 void    MSG_WriteBits(int value, int bits);
 int     MSG_WriteDeltaUsercmd(const usercmd_t *from, const usercmd_t *cmd, int version);
 int     MSG_WriteDeltaUsercmd_Enhanced(const usercmd_t *from, const usercmd_t *cmd, int version);
@@ -134,6 +158,8 @@ size_t  MSG_ReadString(char *dest, size_t size);
 size_t  MSG_ReadStringLine(char *dest, size_t size);
 #if USE_CLIENT
 void    MSG_ReadPos(vec3_t pos);
+#endif
+#if USE_CLIENT || USE_LOADGEN
 void    MSG_ReadDir(vec3_t vector);
 #endif
 int     MSG_ReadBits(int bits);
@@ -142,9 +168,11 @@ void    MSG_ReadDeltaUsercmd_Hacked(const usercmd_t *from, usercmd_t *to);
 void    MSG_ReadDeltaUsercmd_Enhanced(const usercmd_t *from, usercmd_t *to, int version);
 int     MSG_ParseEntityBits(int *bits);
 void    MSG_ParseDeltaEntity(const entity_state_t *from, entity_state_t *to, int number, int bits, msgEsFlags_t flags);
-#if USE_CLIENT
+#if USE_CLIENT || USE_LOADGEN
 void    MSG_ParseDeltaPlayerstate_Default(const player_state_t *from, player_state_t *to, int flags);
 void    MSG_ParseDeltaPlayerstate_Enhanced(const player_state_t *from, player_state_t *to, int flags, int extraflags);
+bool    MSG_ParseTEntPacket(tent_params_t *te);
+void    MSG_ParseStartSoundPacket(snd_params_t *snd);
 #endif
 void    MSG_ParseDeltaPlayerstate_Packet(const player_state_t *from, player_state_t *to, int flags);
 
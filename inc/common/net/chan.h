@@ -36,6 +36,9 @@ typedef struct netchan_s {
     bool        fatal_error;
 
     netsrc_t    sock;
+#if USE_LOADGEN
+    qsocket_t   privsock;           // sends through this instead of sock if not -1
+#endif
 
     int         dropped;            // between last packet and previous
     unsigned    total_dropped;      // for statistics
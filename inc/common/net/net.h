@@ -95,6 +95,14 @@ typedef struct netadr_s {
     uint32_t scope_id;  // IPv6 crap
 } netadr_t;
 
+// piece of outgoing datagram, sent with a single system call
+typedef struct {
+    const void  *data;
+    size_t      len;
+} netvec_t;
+
+#define NET_MAX_VECS    4
+
 typedef enum netstate_e {
     NS_DISCONNECTED,// no socket opened
     NS_CONNECTING,  // connect() not yet completed
@@ -207,6 +215,18 @@ bool        NET_GetAddress(netsrc_t sock, netadr_t *adr);
 void        NET_GetPackets(netsrc_t sock, void (*packet_cb)(void));
 bool        NET_SendPacket(netsrc_t sock, const void *data,
                            size_t len, const netadr_t *to);
+bool        NET_SendPacketv(netsrc_t sock, const netvec_t *vec,
+                            int count, const netadr_t *to);
+void        NET_BeginBatch(netsrc_t sock);
+void        NET_FlushBatch(netsrc_t sock);
+
+#if USE_LOADGEN
+qsocket_t   NET_OpenPrivateSocket(netadrtype_t type);
+void        NET_ClosePrivateSocket(qsocket_t s);
+int         NET_RecvPrivate(qsocket_t s, void *data, size_t len, netadr_t *from);
+bool        NET_SendPrivate(qsocket_t s, const void *data, size_t len, const netadr_t *to);
+bool        NET_SendPrivatev(qsocket_t s, const netvec_t *vec, int count, const netadr_t *to);
+#endif
 
 char        *NET_AdrToString(const netadr_t *a);
 bool        NET_StringToAdr(const char *s, netadr_t *a, int default_port);
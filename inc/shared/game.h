@@ -240,4 +240,32 @@ typedef struct {
     int         max_edicts;
 } game_export_t;
 
+//===============================================================
+
+//
+// optional extended interface, negotiated through GetGameAPIEx entry point
+// exported by the game library. Called after GetGameAPI and before Init.
+// Structures may only be extended by appending new fields; check
+// structsize before using any field added after the first version.
+//
+
+#define GAME_API_VERSION_EX     1
+
+typedef struct {
+    uint32_t    apiversion;
+    uint32_t    structsize;
+
+    // fills list with linked solid and trigger edicts whose bounding boxes
+    // touch the cube enclosing the sphere, sorted by entity number.
+    // caller must do the exact distance test.
+    int (*RadiusEdicts)(const vec3_t origin, float radius, edict_t **list, int maxcount);
+} game_import_ex_t;
+
+typedef struct {
+    uint32_t    apiversion;
+    uint32_t    structsize;
+} game_export_ex_t;
+
+typedef const game_export_ex_t *(*game_entry_ex_t)(const game_import_ex_t *);
+
 #endif // GAME_H
@@ -134,6 +134,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #define q_unused            __attribute__((unused))
 
+#define q_threadlocal       __thread
+
 #else /* __GNUC__ */
 
 #define q_printf(f, a)
@@ -156,4 +158,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #define q_unused
 
+#ifdef _MSC_VER
+#define q_threadlocal       __declspec(thread)
+#else
+#define q_threadlocal       _Thread_local
+#endif
+
 #endif /* !__GNUC__ */
@@ -35,6 +35,7 @@ void    Sys_FreeLibrary(void *handle);
 void    *Sys_GetProcAddress(void *handle, const char *sym);
 
 unsigned    Sys_Milliseconds(void);
+uint64_t    Sys_Microseconds(void);
 void    Sys_Sleep(int msec);
 
 void    Sys_Init(void);
@@ -76,6 +77,10 @@ typedef struct asyncwork_s {
 void Sys_QueueAsyncWork(asyncwork_t *work);
 #endif
 
+// calls func(arg, index) for each index in [0, count) using up to numthreads
+// threads, including the calling one. returns when all calls have completed.
+void Sys_ParallelFor(int numthreads, int count, void (*func)(void *, int), void *arg);
+
 extern cvar_t   *sys_basedir;
 extern cvar_t   *sys_libdir;
 extern cvar_t   *sys_homedir;
@@ -442,6 +442,7 @@ extern  game_locals_t   game;
 extern  level_locals_t  level;
 extern  game_import_t   gi;
 extern  game_export_t   globals;
+extern  const game_import_ex_t  *gix;
 extern  spawn_temp_t    st;
 
 extern  int sm_meat_index;
@@ -612,6 +613,9 @@ void Touch_Item(edict_t *ent, edict_t *other, cplane_t *plane, csurface_t *surf)
 bool    KillBox(edict_t *ent);
 void    G_ProjectSource(const vec3_t point, const vec3_t distance, const vec3_t forward, const vec3_t right, vec3_t result);
 edict_t *G_Find(edict_t *from, int fieldofs, char *match);
+void    G_SetTargetname(edict_t *ent, char *targetname);
+void    G_ClearTargetnames(void);
+void    G_IndexTargetnames(void);
 edict_t *findradius(edict_t *from, vec3_t org, float rad);
 edict_t *G_PickTarget(char *targetname);
 void    G_UseTargets(edict_t *ent, edict_t *activator);
@@ -802,6 +806,14 @@ void ChaseNext(edict_t *ent);
 void ChasePrev(edict_t *ent);
 void GetChaseTarget(edict_t *ent);
 
+//
+// g_save.c
+//
+void InitSavePointers(void);
+void WriteGame(const char *filename, qboolean autosave);
+void WriteLevel(const char *filename);
+void ReadLevel(const char *filename);
+
 //============================================================================
 
 // client_t->anim_priority
@@ -1093,4 +1105,8 @@ struct edict_s {
     // common data blocks
     moveinfo_t      moveinfo;
     monsterinfo_t   monsterinfo;
+
+    // targetname index, not saved
+    edict_t     *targetname_next;
+    int         targetname_hash;    // bucket + 1, 0 if not indexed
 };
@@ -22,6 +22,7 @@ game_locals_t   game;
 level_locals_t  level;
 game_import_t   gi;
 game_export_t   globals;
+const game_import_ex_t  *gix;
 spawn_temp_t    st;
 
 int sm_meat_index;
@@ -173,12 +174,16 @@ void InitGame(void)
     // items
     InitItems();
 
+    // savegame pointer lookup
+    InitSavePointers();
+
     game.helpmessage1[0] = 0;
     game.helpmessage2[0] = 0;
 
     // initialize all entities for this game
     game.maxentities = maxentities->value;
     clamp(game.maxentities, (int)maxclients->value + 1, MAX_EDICTS);
+    G_ClearTargetnames();
     g_edicts = gi.TagMalloc(game.maxentities * sizeof(g_edicts[0]), TAG_GAME);
     globals.edicts = g_edicts;
     globals.max_edicts = game.maxentities;
@@ -228,6 +233,28 @@ q_exported game_export_t *GetGameAPI(game_import_t *import)
     return &globals;
 }
 
+/*
+=================
+GetGameAPIEx
+
+Called by servers that support the extended interface.
+Extensions are used only if server provides all of them.
+=================
+*/
+q_exported const game_export_ex_t *GetGameAPIEx(const game_import_ex_t *import)
+{
+    static const game_export_ex_t globals_ex = {
+        .apiversion = GAME_API_VERSION_EX,
+        .structsize = sizeof(game_export_ex_t),
+    };
+
+    if (import->apiversion >= GAME_API_VERSION_EX &&
+        import->structsize >= sizeof(game_import_ex_t))
+        gix = import;
+
+    return &globals_ex;
+}
+
 #ifndef GAME_HARD_LINKED
 // this is only here so the functions in q_shared.c can link
 void Com_LPrintf(print_type_t type, const char *fmt, ...)
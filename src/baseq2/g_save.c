@@ -501,9 +501,48 @@ static void write_index(FILE *f, void *p, size_t size, void *start, int max_inde
     write_int(f, (int)(diff / size));
 }
 
+// maps (pointer, type) pairs to save_ptrs indices, open addressing
+#define PTR_HASH_SIZE   2048
+
+static int ptr_hash[PTR_HASH_SIZE];     // index + 1, 0 if empty
+
+static unsigned hash_pointer(const void *p, ptr_type_t type)
+{
+    uintptr_t v = (uintptr_t)p;
+
+    return ((v >> 4) ^ (v >> 16) ^ (type * 31)) & (PTR_HASH_SIZE - 1);
+}
+
+/*
+=================
+InitSavePointers
+
+Builds hash table for looking up function pointers when saving.
+=================
+*/
+void InitSavePointers(void)
+{
+    const save_ptr_t *ptr;
+    unsigned hash;
+    int i;
+
+    if (num_save_ptrs > PTR_HASH_SIZE / 2)
+        gi.error("%s: too many pointers", __func__);
+
+    memset(ptr_hash, 0, sizeof(ptr_hash));
+
+    for (i = 0, ptr = save_ptrs; i < num_save_ptrs; i++, ptr++) {
+        hash = hash_pointer(ptr->ptr, ptr->type);
+        while (ptr_hash[hash])
+            hash = (hash + 1) & (PTR_HASH_SIZE - 1);
+        ptr_hash[hash] = i + 1;
+    }
+}
+
 static void write_pointer(FILE *f, void *p, ptr_type_t type)
 {
     const save_ptr_t *ptr;
+    unsigned hash;
     int i;
 
     if (!p) {
@@ -511,11 +550,14 @@ static void write_pointer(FILE *f, void *p, ptr_type_t type)
         return;
     }
 
-    for (i = 0, ptr = save_ptrs; i < num_save_ptrs; i++, ptr++) {
+    hash = hash_pointer(p, type);
+    while ((i = ptr_hash[hash]) != 0) {
+        ptr = &save_ptrs[i - 1];
         if (ptr->type == type && ptr->ptr == p) {
-            write_int(f, i);
+            write_int(f, i - 1);
             return;
         }
+        hash = (hash + 1) & (PTR_HASH_SIZE - 1);
     }
 
     fclose(f);
@@ -865,6 +907,7 @@ void ReadGame(const char *filename)
         gi.error("Savegame has bad maxentities");
     }
 
+    G_ClearTargetnames();
     g_edicts = gi.TagMalloc(game.maxentities * sizeof(g_edicts[0]), TAG_GAME);
     globals.edicts = g_edicts;
     globals.max_edicts = game.maxentities;
@@ -949,6 +992,7 @@ void ReadLevel(const char *filename)
         gi.error("Couldn't open %s", filename);
 
     // wipe all the entities
+    G_ClearTargetnames();
     memset(g_edicts, 0, game.maxentities * sizeof(g_edicts[0]));
     globals.num_edicts = maxclients->value + 1;
 
@@ -991,6 +1035,9 @@ void ReadLevel(const char *filename)
 
     fclose(f);
 
+    // targetnames were read directly into edicts
+    G_IndexTargetnames();
+
     // mark all clients as unconnected
     for (i = 0 ; i < maxclients->value ; i++) {
         ent = &g_edicts[i + 1];
@@ -504,6 +504,9 @@ void ED_ParseEdict(const char **data, edict_t *ent)
 
     if (!init)
         memset(ent, 0, sizeof(*ent));
+
+    // field was parsed directly into the edict, index it now
+    G_SetTargetname(ent, ent->targetname);
 }
 
 
@@ -585,6 +588,7 @@ void SpawnEntities(const char *mapname, const char *entities, const char *spawnp
     gi.FreeTags(TAG_LEVEL);
 
     memset(&level, 0, sizeof(level));
+    G_ClearTargetnames();
     memset(g_edicts, 0, game.maxentities * sizeof(g_edicts[0]));
 
     Q_strlcpy(level.mapname, mapname, sizeof(level.mapname));
@@ -274,6 +274,89 @@ void SVCmd_WriteIP_f(void)
     fclose(f);
 }
 
+/*
+=================
+SVCmd_SaveTest_f
+
+Times savegame code on the current level. Level is read back right after
+being written, so this is meant for testing only.
+=================
+*/
+void SVCmd_SaveTest_f(void)
+{
+    char    gamename[MAX_OSPATH], levelname[MAX_OSPATH];
+    bool    connected[MAX_CLIENTS];
+    clock_t start, times[3] = { 0 };
+    cvar_t  *gamedir;
+    size_t  len;
+    int     i, j, count, numents;
+
+    count = gi.argc() > 2 ? atoi(gi.argv(2)) : 10;
+    clamp(count, 1, 1000);
+
+    gamedir = gi.cvar("fs_gamedir", "", 0);
+    if (!*gamedir->string) {
+        gi.cprintf(NULL, PRINT_HIGH, "Game directory not set\n");
+        return;
+    }
+
+    len = Q_snprintf(gamename, sizeof(gamename), "%s/savetest.ssv", gamedir->string);
+    if (len >= sizeof(gamename)) {
+        gi.cprintf(NULL, PRINT_HIGH, "File name too long\n");
+        return;
+    }
+    len = Q_snprintf(levelname, sizeof(levelname), "%s/savetest.sav", gamedir->string);
+    if (len >= sizeof(levelname)) {
+        gi.cprintf(NULL, PRINT_HIGH, "File name too long\n");
+        return;
+    }
+
+    numents = 0;
+    for (i = 0; i < globals.num_edicts; i++) {
+        if (g_edicts[i].inuse)
+            numents++;
+    }
+
+    for (i = 0; i < count; i++) {
+        start = clock();
+        WriteGame(gamename, true);
+        times[0] += clock() - start;
+
+        start = clock();
+        WriteLevel(levelname);
+        times[1] += clock() - start;
+
+        // ReadLevel expects world links cleared and clients disconnected
+        for (j = 0; j < globals.num_edicts; j++) {
+            if (g_edicts[j].inuse)
+                gi.unlinkentity(&g_edicts[j]);
+        }
+        for (j = 0; j < game.maxclients; j++) {
+            connected[j] = game.clients[j].pers.connected;
+        }
+
+        start = clock();
+        ReadLevel(levelname);
+        times[2] += clock() - start;
+
+        for (j = 0; j < game.maxclients; j++) {
+            game.clients[j].pers.connected = connected[j];
+        }
+    }
+
+    remove(gamename);
+    remove(levelname);
+
+    gi.cprintf(NULL, PRINT_HIGH,
+               "%d entities, %d iterations, msec per call:\n"
+               "WriteGame  %8.3f\n"
+               "WriteLevel %8.3f\n"
+               "ReadLevel  %8.3f\n", numents, count,
+               times[0] * 1000.0 / CLOCKS_PER_SEC / count,
+               times[1] * 1000.0 / CLOCKS_PER_SEC / count,
+               times[2] * 1000.0 / CLOCKS_PER_SEC / count);
+}
+
 /*
 =================
 ServerCommand
@@ -298,6 +381,8 @@ void    ServerCommand(void)
         SVCmd_ListIP_f();
     else if (Q_stricmp(cmd, "writeip") == 0)
         SVCmd_WriteIP_f();
+    else if (Q_stricmp(cmd, "savetest") == 0)
+        SVCmd_SaveTest_f();
     else
         gi.cprintf(NULL, PRINT_HIGH, "Unknown server command \"%s\"\n", cmd);
 }
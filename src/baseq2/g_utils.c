@@ -28,6 +28,128 @@ void G_ProjectSource(const vec3_t point, const vec3_t distance, const vec3_t for
 }
 
 
+/*
+=============
+Targetname index
+
+Entities with a targetname are kept in hash chains sorted by entity number,
+so that G_Find can walk only the entities that may match while preserving
+the usual iteration order. Hash is case insensitive, like the comparison.
+=============
+*/
+
+#define TARGETNAME_HASH_SIZE    1024
+
+static edict_t  *targetname_hash[TARGETNAME_HASH_SIZE];
+
+static unsigned hash_targetname(const char *s)
+{
+    unsigned hash = 0;
+
+    while (*s)
+        hash = hash * 31 + Q_tolower(*s++);
+
+    return (hash ^ (hash >> 10)) & (TARGETNAME_HASH_SIZE - 1);
+}
+
+static void unindex_targetname(edict_t *ent)
+{
+    edict_t **back;
+
+    if (!ent->targetname_hash)
+        return;
+
+    for (back = &targetname_hash[ent->targetname_hash - 1]; *back; back = &(*back)->targetname_next) {
+        if (*back == ent) {
+            *back = ent->targetname_next;
+            break;
+        }
+    }
+
+    ent->targetname_next = NULL;
+    ent->targetname_hash = 0;
+}
+
+static void index_targetname(edict_t *ent)
+{
+    edict_t **back;
+    unsigned hash;
+
+    if (!ent->targetname)
+        return;
+
+    hash = hash_targetname(ent->targetname);
+    for (back = &targetname_hash[hash]; *back && *back < ent; back = &(*back)->targetname_next)
+        ;
+
+    ent->targetname_next = *back;
+    ent->targetname_hash = hash + 1;
+    *back = ent;
+}
+
+/*
+=============
+G_SetTargetname
+
+All targetname changes must go through here to keep the index valid.
+=============
+*/
+void G_SetTargetname(edict_t *ent, char *targetname)
+{
+    unindex_targetname(ent);
+    ent->targetname = targetname;
+    index_targetname(ent);
+}
+
+/*
+=============
+G_ClearTargetnames
+
+Empties the index. Must be called before edicts are wiped in bulk.
+=============
+*/
+void G_ClearTargetnames(void)
+{
+    memset(targetname_hash, 0, sizeof(targetname_hash));
+}
+
+/*
+=============
+G_IndexTargetnames
+
+Rebuilds the index from scratch after edicts were loaded in bulk.
+=============
+*/
+void G_IndexTargetnames(void)
+{
+    edict_t *ent;
+
+    G_ClearTargetnames();
+
+    for (ent = g_edicts; ent < &g_edicts[globals.num_edicts]; ent++) {
+        ent->targetname_next = NULL;
+        ent->targetname_hash = 0;
+        if (ent->inuse)
+            index_targetname(ent);
+    }
+}
+
+static edict_t *find_targetname(edict_t *from, char *match)
+{
+    edict_t *ent;
+
+    for (ent = targetname_hash[hash_targetname(match)]; ent; ent = ent->targetname_next) {
+        if (ent < from)
+            continue;
+        if (!ent->inuse)
+            continue;
+        if (!Q_stricmp(ent->targetname, match))
+            return ent;
+    }
+
+    return NULL;
+}
+
 /*
 =============
 G_Find
@@ -49,6 +171,9 @@ edict_t *G_Find(edict_t *from, int fieldofs, char *match)
     else
         from++;
 
+    if (fieldofs == FOFS(targetname))
+        return find_targetname(from, match);
+
     for (; from < &g_edicts[globals.num_edicts] ; from++) {
         if (!from->inuse)
             continue;
@@ -63,6 +188,46 @@ edict_t *G_Find(edict_t *from, int fieldofs, char *match)
 }
 
 
+static bool radius_check(edict_t *ent, vec3_t org, float rad)
+{
+    vec3_t  eorg;
+    int     j;
+
+    if (!ent->inuse)
+        return false;
+    if (ent->solid == SOLID_NOT)
+        return false;
+    for (j = 0 ; j < 3 ; j++)
+        eorg[j] = org[j] - (ent->s.origin[j] + (ent->mins[j] + ent->maxs[j]) * 0.5f);
+    return VectorLength(eorg) <= rad;
+}
+
+// only linked edicts are returned by the server, world is never linked.
+// area tree is queried on each call, since callers may link, unlink or
+// move edicts between calls (T_RadiusDamage spawning gibs and debris),
+// and candidates are checked again just like the linear scan does.
+static edict_t *findradius_linked(edict_t *from, vec3_t org, float rad)
+{
+    static edict_t  *list[MAX_EDICTS];
+    int     i, count;
+
+    if (!from) {
+        if (radius_check(g_edicts, org, rad))
+            return g_edicts;
+        from = g_edicts;
+    }
+
+    count = gix->RadiusEdicts(org, rad, list, MAX_EDICTS);
+    for (i = 0; i < count; i++) {
+        if (list[i] <= from)
+            continue;
+        if (radius_check(list[i], org, rad))
+            return list[i];
+    }
+
+    return NULL;
+}
+
 /*
 =================
 findradius
@@ -74,23 +239,16 @@ findradius (origin, radius)
 */
 edict_t *findradius(edict_t *from, vec3_t org, float rad)
 {
-    vec3_t  eorg;
-    int     j;
+    if (gix)
+        return findradius_linked(from, org, rad);
 
     if (!from)
         from = g_edicts;
     else
         from++;
     for (; from < &g_edicts[globals.num_edicts]; from++) {
-        if (!from->inuse)
-            continue;
-        if (from->solid == SOLID_NOT)
-            continue;
-        for (j = 0 ; j < 3 ; j++)
-            eorg[j] = org[j] - (from->s.origin[j] + (from->mins[j] + from->maxs[j]) * 0.5f);
-        if (VectorLength(eorg) > rad)
-            continue;
-        return from;
+        if (radius_check(from, org, rad))
+            return from;
     }
 
     return NULL;
@@ -427,6 +585,8 @@ void G_FreeEdict(edict_t *ed)
         return;
     }
 
+    unindex_targetname(ed);
+
     memset(ed, 0, sizeof(*ed));
     ed->classname = "freed";
     ed->freetime = level.time;
@@ -620,36 +620,12 @@ void CL_SendCmd(void);
 // parse.c
 //
 
-typedef struct {
-    int type;
-    vec3_t pos1;
-    vec3_t pos2;
-    vec3_t offset;
-    vec3_t dir;
-    int count;
-    int color;
-    int entity1;
-    int entity2;
-    int time;
-} tent_params_t;
-
 typedef struct {
     int entity;
     int weapon;
     int silenced;
 } mz_params_t;
 
-typedef struct {
-    int     flags;
-    int     index;
-    int     entity;
-    int     channel;
-    vec3_t  pos;
-    float   volume;
-    float   attenuation;
-    float   timeofs;
-} snd_params_t;
-
 extern tent_params_t    te;
 extern mz_params_t      mz;
 extern snd_params_t     snd;
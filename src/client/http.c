@@ -870,6 +870,8 @@ fail2:
             if (rename(dl->path, temp))
                 Com_EPrintf("[HTTP] Failed to rename '%s' to '%s': %s\n",
                             dl->path, dl->queue->path, strerror(errno));
+            else
+                FS_FileCreated(dl->queue->path);
             dl->path[0] = 0;
 
             //a pak file is very special...
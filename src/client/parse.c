@@ -656,124 +656,8 @@ snd_params_t    snd;
 
 static void CL_ParseTEntPacket(void)
 {
-    te.type = MSG_ReadByte();
-
-    switch (te.type) {
-    case TE_BLOOD:
-    case TE_GUNSHOT:
-    case TE_SPARKS:
-    case TE_BULLET_SPARKS:
-    case TE_SCREEN_SPARKS:
-    case TE_SHIELD_SPARKS:
-    case TE_SHOTGUN:
-    case TE_BLASTER:
-    case TE_GREENBLOOD:
-    case TE_BLASTER2:
-    case TE_FLECHETTE:
-    case TE_HEATBEAM_SPARKS:
-    case TE_HEATBEAM_STEAM:
-    case TE_MOREBLOOD:
-    case TE_ELECTRIC_SPARKS:
-        MSG_ReadPos(te.pos1);
-        MSG_ReadDir(te.dir);
-        break;
-
-    case TE_SPLASH:
-    case TE_LASER_SPARKS:
-    case TE_WELDING_SPARKS:
-    case TE_TUNNEL_SPARKS:
-        te.count = MSG_ReadByte();
-        MSG_ReadPos(te.pos1);
-        MSG_ReadDir(te.dir);
-        te.color = MSG_ReadByte();
-        break;
-
-    case TE_BLUEHYPERBLASTER:
-    case TE_RAILTRAIL:
-    case TE_BUBBLETRAIL:
-    case TE_DEBUGTRAIL:
-    case TE_BUBBLETRAIL2:
-    case TE_BFG_LASER:
-        MSG_ReadPos(te.pos1);
-        MSG_ReadPos(te.pos2);
-        break;
-
-    case TE_GRENADE_EXPLOSION:
-    case TE_GRENADE_EXPLOSION_WATER:
-    case TE_EXPLOSION2:
-    case TE_PLASMA_EXPLOSION:
-    case TE_ROCKET_EXPLOSION:
-    case TE_ROCKET_EXPLOSION_WATER:
-    case TE_EXPLOSION1:
-    case TE_EXPLOSION1_NP:
-    case TE_EXPLOSION1_BIG:
-    case TE_BFG_EXPLOSION:
-    case TE_BFG_BIGEXPLOSION:
-    case TE_BOSSTPORT:
-    case TE_PLAIN_EXPLOSION:
-    case TE_CHAINFIST_SMOKE:
-    case TE_TRACKER_EXPLOSION:
-    case TE_TELEPORT_EFFECT:
-    case TE_DBALL_GOAL:
-    case TE_WIDOWSPLASH:
-    case TE_NUKEBLAST:
-        MSG_ReadPos(te.pos1);
-        break;
-
-    case TE_PARASITE_ATTACK:
-    case TE_MEDIC_CABLE_ATTACK:
-    case TE_HEATBEAM:
-    case TE_MONSTER_HEATBEAM:
-        te.entity1 = MSG_ReadShort();
-        MSG_ReadPos(te.pos1);
-        MSG_ReadPos(te.pos2);
-        break;
-
-    case TE_GRAPPLE_CABLE:
-        te.entity1 = MSG_ReadShort();
-        MSG_ReadPos(te.pos1);
-        MSG_ReadPos(te.pos2);
-        MSG_ReadPos(te.offset);
-        break;
-
-    case TE_LIGHTNING:
-        te.entity1 = MSG_ReadShort();
-        te.entity2 = MSG_ReadShort();
-        MSG_ReadPos(te.pos1);
-        MSG_ReadPos(te.pos2);
-        break;
-
-    case TE_FLASHLIGHT:
-        MSG_ReadPos(te.pos1);
-        te.entity1 = MSG_ReadShort();
-        break;
-
-    case TE_FORCEWALL:
-        MSG_ReadPos(te.pos1);
-        MSG_ReadPos(te.pos2);
-        te.color = MSG_ReadByte();
-        break;
-
-    case TE_STEAM:
-        te.entity1 = MSG_ReadShort();
-        te.count = MSG_ReadByte();
-        MSG_ReadPos(te.pos1);
-        MSG_ReadDir(te.dir);
-        te.color = MSG_ReadByte();
-        te.entity2 = MSG_ReadShort();
-        if (te.entity1 != -1) {
-            te.time = MSG_ReadLong();
-        }
-        break;
-
-    case TE_WIDOWBEAMOUT:
-        te.entity1 = MSG_ReadShort();
-        MSG_ReadPos(te.pos1);
-        break;
-
-    default:
+    if (!MSG_ParseTEntPacket(&te))
         Com_Error(ERR_DROP, "%s: bad type", __func__);
-    }
 }
 
 static void CL_ParseMuzzleFlashPacket(int mask)
@@ -792,49 +676,16 @@ static void CL_ParseMuzzleFlashPacket(int mask)
 
 static void CL_ParseStartSoundPacket(void)
 {
-    int flags, channel, entity;
+    MSG_ParseStartSoundPacket(&snd);
 
-    flags = MSG_ReadByte();
-    if ((flags & (SND_ENT | SND_POS)) == 0)
+    if ((snd.flags & (SND_ENT | SND_POS)) == 0)
         Com_Error(ERR_DROP, "%s: neither SND_ENT nor SND_POS set", __func__);
 
-    snd.index = MSG_ReadByte();
     if (snd.index == -1)
         Com_Error(ERR_DROP, "%s: read past end of message", __func__);
 
-    if (flags & SND_VOLUME)
-        snd.volume = MSG_ReadByte() / 255.0f;
-    else
-        snd.volume = DEFAULT_SOUND_PACKET_VOLUME;
-
-    if (flags & SND_ATTENUATION)
-        snd.attenuation = MSG_ReadByte() / 64.0f;
-    else
-        snd.attenuation = DEFAULT_SOUND_PACKET_ATTENUATION;
-
-    if (flags & SND_OFFSET)
-        snd.timeofs = MSG_ReadByte() / 1000.0f;
-    else
-        snd.timeofs = 0;
-
-    if (flags & SND_ENT) {
-        // entity relative
-        channel = MSG_ReadShort();
-        entity = channel >> 3;
-        if (entity < 0 || entity >= MAX_EDICTS)
-            Com_Error(ERR_DROP, "%s: bad entity: %d", __func__, entity);
-        snd.entity = entity;
-        snd.channel = channel & 7;
-    } else {
-        snd.entity = 0;
-        snd.channel = 0;
-    }
-
-    // positioned in space
-    if (flags & SND_POS)
-        MSG_ReadPos(snd.pos);
-
-    snd.flags = flags;
+    if (snd.entity < 0 || snd.entity >= MAX_EDICTS)
+        Com_Error(ERR_DROP, "%s: bad entity: %d", __func__, snd.entity);
 
     SHOWNET(2, "    %s\n", cl.configstrings[CS_SOUNDS + snd.index]);
 }
@@ -101,11 +101,11 @@ void AL_Shutdown(void)
     QAL_Shutdown();
 }
 
-sfxcache_t *AL_UploadSfx(sfx_t *s)
+sfxcache_t *AL_UploadSfx(sfx_t *s, const wavinfo_t *info)
 {
     sfxcache_t *sc;
-    ALsizei size = s_info.samples * s_info.width;
-    ALenum format = s_info.width == 2 ? AL_FORMAT_MONO16 : AL_FORMAT_MONO8;
+    ALsizei size = info->samples * info->width;
+    ALenum format = info->width == 2 ? AL_FORMAT_MONO16 : AL_FORMAT_MONO8;
     ALuint name;
 
     if (!size) {
@@ -115,7 +115,7 @@ sfxcache_t *AL_UploadSfx(sfx_t *s)
 
     qalGetError();
     qalGenBuffers(1, &name);
-    qalBufferData(name, format, s_info.data, size, s_info.rate);
+    qalBufferData(name, format, info->data, size, info->rate);
     if (qalGetError() != AL_NO_ERROR) {
         s->error = Q_ERR_LIBRARY_ERROR;
         return NULL;
@@ -123,17 +123,17 @@ sfxcache_t *AL_UploadSfx(sfx_t *s)
 
 #if 0
     // specify OpenAL-Soft style loop points
-    if (s_info.loopstart > 0 && qalIsExtensionPresent("AL_SOFT_loop_points")) {
-        ALint points[2] = { s_info.loopstart, s_info.samples };
+    if (info->loopstart > 0 && qalIsExtensionPresent("AL_SOFT_loop_points")) {
+        ALint points[2] = { info->loopstart, info->samples };
         qalBufferiv(name, AL_LOOP_POINTS_SOFT, points);
     }
 #endif
 
     // allocate placeholder sfxcache
     sc = s->cache = S_Malloc(sizeof(*sc));
-    sc->length = s_info.samples * 1000 / s_info.rate; // in msec
-    sc->loopstart = s_info.loopstart;
-    sc->width = s_info.width;
+    sc->length = info->samples * 1000 / info->rate; // in msec
+    sc->loopstart = info->loopstart;
+    sc->width = info->width;
     sc->size = size;
     sc->bufnum = name;
 
@@ -53,12 +53,14 @@ static int          num_sfx;
 playsound_t s_playsounds[MAX_PLAYSOUNDS];
 playsound_t s_freeplays;
 playsound_t s_pendingplays;
+static playsound_t  s_loadingplays;  // waiting for sfx data
 
 cvar_t      *s_volume;
 cvar_t      *s_ambient;
 #ifdef _DEBUG
 cvar_t      *s_show;
 #endif
+cvar_t      *s_threads;
 
 static cvar_t   *s_enable;
 static cvar_t   *s_auto_focus;
@@ -114,6 +116,8 @@ static void S_SoundList_f(void)
         } else {
             if (sfx->name[0] == '*')
                 Com_Printf("  placeholder : %s\n", sfx->name);
+            else if (sfx->load)
+                Com_Printf("  loading     : %s\n", sfx->name);
             else
                 Com_Printf("  not loaded  : %s (%s)\n",
                            sfx->name, Q_ErrorString(sfx->error));
@@ -161,6 +165,7 @@ void S_Init(void)
 #endif
     s_auto_focus = Cvar_Get("s_auto_focus", "0", 0);
     s_swapstereo = Cvar_Get("s_swapstereo", "0", 0);
+    s_threads = Cvar_Get("s_threads", "4", 0);
 
     // start one of available sound engines
     s_started = SS_NOT;
@@ -207,6 +212,7 @@ fail:
 
 static void S_FreeSound(sfx_t *sfx)
 {
+    S_CancelLoadSound(sfx);
 #if USE_OPENAL
     if (s_started == SS_OAL)
         AL_DeleteSfx(sfx);
@@ -258,7 +264,9 @@ void S_Shutdown(void)
 
     Cmd_Deregister(c_sound);
 
-    Z_LeakTest(TAG_SOUND);
+    // orphaned loads still in flight are freed on completion
+    if (!s_numloads)
+        Z_LeakTest(TAG_SOUND);
 }
 
 void S_Activate(void)
@@ -422,7 +430,7 @@ qhandle_t S_RegisterSound(const char *name)
     }
 
     if (!s_registering) {
-        S_LoadSound(sfx);
+        S_QueueLoadSound(sfx);
     }
 
     return (sfx - known_sfx) + 1;
@@ -457,7 +465,8 @@ static sfx_t *S_RegisterSexedSound(int entnum, const char *base)
     sfx = S_FindName(buffer, FS_NormalizePath(buffer, buffer));
 
     // see if it exists
-    if (sfx && !sfx->truename && !s_registering && !S_LoadSound(sfx)) {
+    if (sfx && !sfx->truename && !sfx->cache && !sfx->load && !s_registering &&
+        (sfx->error || FS_LoadFile(sfx->name, NULL) < 0)) {
         // no, revert to the male sound in the pak0.pak
         if (Q_concat(buffer, MAX_QPATH, "sound/player/male/", base + 1) < MAX_QPATH) {
             FS_NormalizePath(buffer, buffer);
@@ -504,7 +513,8 @@ S_EndRegistration
 */
 void S_EndRegistration(void)
 {
-    int     i;
+    sfx_t   *list[MAX_SFX];
+    int     i, count;
     sfx_t   *sfx;
 #if USE_SNDDMA
     sfxcache_t *sc;
@@ -540,11 +550,12 @@ void S_EndRegistration(void)
     }
 
     // load everything in
-    for (i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++) {
+    for (i = count = 0, sfx = known_sfx; i < num_sfx; i++, sfx++) {
         if (!sfx->name[0])
             continue;
-        S_LoadSound(sfx);
+        list[count++] = sfx;
     }
+    S_LoadSoundList(list, count);
 
     s_registering = false;
 }
@@ -755,7 +766,7 @@ void S_IssuePlaysound(playsound_t *ps)
         return;
     }
 
-    sc = S_LoadSound(ps->sfx);
+    sc = ps->sfx->cache;
     if (!sc) {
         Com_Printf("S_IssuePlaysound: couldn't load %s\n", ps->sfx->name);
         S_FreePlaysound(ps);
@@ -795,6 +806,27 @@ void S_IssuePlaysound(playsound_t *ps)
 // Start a sound effect
 // =======================================================================
 
+/*
+=================
+S_QueuePlaysound
+
+Sorts the playsound into the pending sound list
+=================
+*/
+static void S_QueuePlaysound(playsound_t *ps)
+{
+    playsound_t *sort;
+
+    for (sort = s_pendingplays.next; sort != &s_pendingplays && sort->begin < ps->begin; sort = sort->next)
+        ;
+
+    ps->next = sort;
+    ps->prev = sort->prev;
+
+    ps->next->prev = ps;
+    ps->prev->next = ps;
+}
+
 /*
 ====================
 S_StartSound
@@ -806,8 +838,7 @@ Entchannel 0 will never override a playing sound
 */
 void S_StartSound(const vec3_t origin, int entnum, int entchannel, qhandle_t hSfx, float vol, float attenuation, float timeofs)
 {
-    sfxcache_t  *sc;
-    playsound_t *ps, *sort;
+    playsound_t *ps;
     sfx_t       *sfx;
 
     if (!s_started)
@@ -826,8 +857,8 @@ void S_StartSound(const vec3_t origin, int entnum, int entchannel, qhandle_t hSf
     }
 
     // make sure the sound is loaded
-    sc = S_LoadSound(sfx);
-    if (!sc)
+    S_QueueLoadSound(sfx);
+    if (!sfx->cache && !sfx->load)
         return;     // couldn't load the sound's data
 
     // make the playsound_t
@@ -858,15 +889,46 @@ void S_StartSound(const vec3_t origin, int entnum, int entchannel, qhandle_t hSf
         ps->begin = DMA_DriftBeginofs(timeofs);
 #endif
 
-    // sort into the pending sound list
-    for (sort = s_pendingplays.next; sort != &s_pendingplays && sort->begin < ps->begin; sort = sort->next)
-        ;
+    // wait for the sound's data if it is still loading
+    if (!sfx->cache) {
+        ps->next = &s_loadingplays;
+        ps->prev = s_loadingplays.prev;
 
-    ps->next = sort;
-    ps->prev = sort->prev;
+        ps->next->prev = ps;
+        ps->prev->next = ps;
+        return;
+    }
 
-    ps->next->prev = ps;
-    ps->prev->next = ps;
+    S_QueuePlaysound(ps);
+}
+
+/*
+====================
+S_ReleasePlaysounds
+
+Called when background load of the sound is finished
+====================
+*/
+void S_ReleasePlaysounds(sfx_t *sfx)
+{
+    playsound_t *ps, *next;
+
+    for (ps = s_loadingplays.next; ps != &s_loadingplays; ps = next) {
+        next = ps->next;
+        if (ps->sfx != sfx)
+            continue;
+
+        if (!sfx->cache) {
+            S_FreePlaysound(ps);
+            continue;
+        }
+
+        // unlink from loading list
+        ps->prev->next = ps->next;
+        ps->next->prev = ps->prev;
+
+        S_QueuePlaysound(ps);
+    }
 }
 
 void S_ParseStartSound(void)
@@ -923,6 +985,7 @@ void S_StopAllSounds(void)
     memset(s_playsounds, 0, sizeof(s_playsounds));
     s_freeplays.next = s_freeplays.prev = &s_freeplays;
     s_pendingplays.next = s_pendingplays.prev = &s_pendingplays;
+    s_loadingplays.next = s_loadingplays.prev = &s_loadingplays;
 
     for (i = 0; i < MAX_PLAYSOUNDS; i++) {
         s_playsounds[i].prev = &s_freeplays;
@@ -19,15 +19,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "sound.h"
 
-wavinfo_t s_info;
-
 #if USE_SNDDMA
 /*
 ================
 ResampleSfx
 ================
 */
-static sfxcache_t *ResampleSfx(sfx_t *sfx)
+static sfxcache_t *ResampleSfx(sfx_t *sfx, const wavinfo_t *info)
 {
     int         outcount;
     int         srcsample;
@@ -36,33 +34,33 @@ static sfxcache_t *ResampleSfx(sfx_t *sfx)
     int         samplefrac, fracstep;
     sfxcache_t  *sc;
 
-    stepscale = (float)s_info.rate / dma.speed;      // this is usually 0.5, 1, or 2
+    stepscale = (float)info->rate / dma.speed;      // this is usually 0.5, 1, or 2
 
-    outcount = s_info.samples / stepscale;
+    outcount = info->samples / stepscale;
     if (!outcount) {
-        Com_DPrintf("%s resampled to zero length\n", s_info.name);
+        Com_DPrintf("%s resampled to zero length\n", info->name);
         sfx->error = Q_ERR_TOO_FEW;
         return NULL;
     }
 
-    sc = sfx->cache = S_Malloc(outcount * s_info.width + sizeof(sfxcache_t) - 1);
+    sc = sfx->cache = S_Malloc(outcount * info->width + sizeof(sfxcache_t) - 1);
 
     sc->length = outcount;
-    sc->loopstart = s_info.loopstart == -1 ? -1 : s_info.loopstart / stepscale;
-    sc->width = s_info.width;
+    sc->loopstart = info->loopstart == -1 ? -1 : info->loopstart / stepscale;
+    sc->width = info->width;
 
 // resample / decimate to the current source rate
 //Com_Printf("%s: %f, %d\n",sfx->name,stepscale,sc->width);
     if (stepscale == 1) {
 // fast special case
         if (sc->width == 1) {
-            memcpy(sc->data, s_info.data, outcount);
+            memcpy(sc->data, info->data, outcount);
         } else {
 #if __BYTE_ORDER == __LITTLE_ENDIAN
-            memcpy(sc->data, s_info.data, outcount << 1);
+            memcpy(sc->data, info->data, outcount << 1);
 #else
             for (i = 0; i < outcount; i++) {
-                ((uint16_t *)sc->data)[i] = LittleShort(((uint16_t *)s_info.data)[i]);
+                ((uint16_t *)sc->data)[i] = LittleShort(((uint16_t *)info->data)[i]);
             }
 #endif
         }
@@ -74,13 +72,13 @@ static sfxcache_t *ResampleSfx(sfx_t *sfx)
             for (i = 0; i < outcount; i++) {
                 srcsample = samplefrac >> 8;
                 samplefrac += fracstep;
-                sc->data[i] = s_info.data[srcsample];
+                sc->data[i] = info->data[srcsample];
             }
         } else {
             for (i = 0; i < outcount; i++) {
                 srcsample = samplefrac >> 8;
                 samplefrac += fracstep;
-                ((uint16_t *)sc->data)[i] = LittleShort(((uint16_t *)s_info.data)[srcsample]);
+                ((uint16_t *)sc->data)[i] = LittleShort(((uint16_t *)info->data)[srcsample]);
             }
         }
     }
@@ -97,10 +95,10 @@ WAV loading
 ===============================================================================
 */
 
-static byte     *data_p;
-static byte     *iff_end;
-static byte     *iff_data;
-static uint32_t iff_chunk_len;
+static q_threadlocal byte     *data_p;
+static q_threadlocal byte     *iff_end;
+static q_threadlocal byte     *iff_data;
+static q_threadlocal uint32_t iff_chunk_len;
 
 static int GetLittleShort(void)
 {
@@ -165,7 +163,7 @@ static void FindChunk(uint32_t search)
 #define TAG_MARK    MakeRawLong('M', 'A', 'R', 'K')
 #define TAG_data    MakeRawLong('d', 'a', 't', 'a')
 
-static bool GetWavinfo(void)
+static const char *GetWavinfo(wavinfo_t *info)
 {
     int format;
     int samples, width;
@@ -174,13 +172,11 @@ static bool GetWavinfo(void)
 // find "RIFF" chunk
     FindChunk(TAG_RIFF);
     if (!data_p) {
-        Com_DPrintf("%s has missing/invalid RIFF chunk\n", s_info.name);
-        return false;
+        return "missing/invalid RIFF chunk";
     }
     chunk = GetLittleLong();
     if (chunk != TAG_WAVE) {
-        Com_DPrintf("%s has missing/invalid WAVE chunk\n", s_info.name);
-        return false;
+        return "missing/invalid WAVE chunk";
     }
 
     iff_data = data_p;
@@ -188,25 +184,21 @@ static bool GetWavinfo(void)
 // get "fmt " chunk
     FindChunk(TAG_fmt);
     if (!data_p) {
-        Com_DPrintf("%s has missing/invalid fmt chunk\n", s_info.name);
-        return false;
+        return "missing/invalid fmt chunk";
     }
     format = GetLittleShort();
     if (format != 1) {
-        Com_DPrintf("%s has non-Microsoft PCM format\n", s_info.name);
-        return false;
+        return "non-Microsoft PCM format";
     }
 
     format = GetLittleShort();
     if (format != 1) {
-        Com_DPrintf("%s has bad number of channels\n", s_info.name);
-        return false;
+        return "bad number of channels";
     }
 
-    s_info.rate = GetLittleLong();
-    if (s_info.rate < 8000 || s_info.rate > 48000) {
-        Com_DPrintf("%s has bad rate\n", s_info.name);
-        return false;
+    info->rate = GetLittleLong();
+    if (info->rate < 8000 || info->rate > 48000) {
+        return "bad rate";
     }
 
     data_p += 4 + 2;
@@ -214,24 +206,22 @@ static bool GetWavinfo(void)
     width = GetLittleShort();
     switch (width) {
     case 8:
-        s_info.width = 1;
+        info->width = 1;
         break;
     case 16:
-        s_info.width = 2;
+        info->width = 2;
         break;
     default:
-        Com_DPrintf("%s has bad width\n", s_info.name);
-        return false;
+        return "bad width";
     }
 
 // get cue chunk
     FindChunk(TAG_cue);
     if (data_p) {
         data_p += 24;
-        s_info.loopstart = GetLittleLong();
-        if (s_info.loopstart < 0 || s_info.loopstart > INT_MAX) {
-            Com_DPrintf("%s has bad loop start\n", s_info.name);
-            return false;
+        info->loopstart = GetLittleLong();
+        if (info->loopstart < 0 || info->loopstart > INT_MAX) {
+            return "bad loop start";
         }
 
         FindNextChunk(TAG_LIST);
@@ -242,63 +232,90 @@ static bool GetWavinfo(void)
                 // this is not a proper parse, but it works with cooledit...
                 data_p += 16;
                 samples = GetLittleLong();    // samples in loop
-                if (samples < 0 || samples > INT_MAX - s_info.loopstart) {
-                    Com_DPrintf("%s has bad loop length\n", s_info.name);
-                    return false;
+                if (samples < 0 || samples > INT_MAX - info->loopstart) {
+                    return "bad loop length";
                 }
-                s_info.samples = s_info.loopstart + samples;
+                info->samples = info->loopstart + samples;
             }
         }
     } else {
-        s_info.loopstart = -1;
+        info->loopstart = -1;
     }
 
 // find data chunk
     FindChunk(TAG_data);
     if (!data_p) {
-        Com_DPrintf("%s has missing/invalid data chunk\n", s_info.name);
-        return false;
+        return "missing/invalid data chunk";
     }
 
-    samples = iff_chunk_len / s_info.width;
+    samples = iff_chunk_len / info->width;
     if (!samples) {
-        Com_DPrintf("%s has zero length\n", s_info.name);
-        return false;
+        return "zero length";
     }
 
-    if (s_info.samples) {
-        if (samples < s_info.samples) {
-            Com_DPrintf("%s has bad loop length\n", s_info.name);
-            return false;
+    if (info->samples) {
+        if (samples < info->samples) {
+            return "bad loop length";
         }
     } else {
-        s_info.samples = samples;
+        info->samples = samples;
     }
 
-    s_info.data = data_p;
+    info->data = data_p;
 
-    return true;
+    return NULL;
 }
 
+
+/*
+===============================================================================
+
+Sound loading
+
+Sound files are opened on the main thread, because filesystem isn't thread
+safe. Opened files are detached from filesystem and read and parsed by
+worker threads. Resampling or uploading is then done on the main thread,
+which owns the zone allocator and the sound device. The mixer never sees
+partially loaded sounds. Files that need decompression can't be detached
+and are still read on the main thread.
+
+===============================================================================
+*/
+
+typedef struct soundload_s {
+    sfx_t       *sfx;           // NULL if sound was freed while loading
+    FILE        *fp;            // detached file, read by worker
+    size_t      filelen;
+    byte        *data;          // file contents
+    bool        detached;       // data allocated by worker
+    int         ret;            // read error
+    const char  *error;         // parse error
+    wavinfo_t   info;
+} soundload_t;
+
+int s_numloads;
+
 /*
 ==============
-S_LoadSound
+S_BeginLoad
+
+Called from the main thread.
 ==============
 */
-sfxcache_t *S_LoadSound(sfx_t *s)
+static soundload_t *S_BeginLoad(sfx_t *s)
 {
-    byte        *data;
-    sfxcache_t  *sc;
-    int         len;
+    soundload_t *load;
+    FILE        *fp;
+    void        *data = NULL;
+    int64_t     len;
     char        *name;
 
     if (s->name[0] == '*')
         return NULL;
 
-// see if still in memory
-    sc = s->cache;
-    if (sc)
-        return sc;
+// see if still in memory or being loaded
+    if (s->cache || s->load)
+        return NULL;
 
 // don't retry after error
     if (s->error)
@@ -310,33 +327,182 @@ sfxcache_t *S_LoadSound(sfx_t *s)
     else
         name = s->name;
 
-    len = FS_LoadFile(name, (void **)&data);
-    if (!data) {
+    len = FS_OpenDetached(name, &fp);
+    if (len == Q_ERR_NOSYS)
+        len = FS_LoadFileEx(name, &data, 0, TAG_SOUND);
+    if (len < 0) {
         s->error = len;
         return NULL;
     }
+    if (len > MAX_LOADFILE) {
+        if (fp)
+            fclose(fp);
+        s->error = Q_ERR_FBIG;
+        return NULL;
+    }
+
+    load = S_Malloc(sizeof(*load));
+    memset(load, 0, sizeof(*load));
+    load->sfx = s;
+    load->fp = fp;
+    load->filelen = len;
+    load->data = data;
+    load->info.name = name;
 
-    memset(&s_info, 0, sizeof(s_info));
-    s_info.name = name;
+    s->load = load;
+    return load;
+}
+
+/*
+==============
+S_RunLoad
 
-    iff_data = data;
-    iff_end = data + len;
-    if (!GetWavinfo()) {
-        s->error = Q_ERR_INVALID_FORMAT;
-        goto fail;
+May be called from any thread.
+==============
+*/
+static void S_RunLoad(soundload_t *load)
+{
+    // zone allocator is not thread safe
+    if (load->fp) {
+        load->data = malloc(load->filelen + 1);
+        load->detached = true;
+        if (!load->data)
+            load->ret = Q_ERR(ENOMEM);
+        else if (fread(load->data, 1, load->filelen, load->fp) != load->filelen)
+            load->ret = Q_ERR_UNEXPECTED_EOF;
+        fclose(load->fp);
+        load->fp = NULL;
+        if (load->ret)
+            return;
     }
 
+    iff_data = load->data;
+    iff_end = load->data + load->filelen;
+    load->error = GetWavinfo(&load->info);
+}
+
+/*
+==============
+S_FinishLoad
+
+Called from the main thread.
+==============
+*/
+static void S_FinishLoad(soundload_t *load)
+{
+    sfx_t *s = load->sfx;
+
+    // discard if sound was freed meanwhile
+    if (s) {
+        s->load = NULL;
+        if (load->ret) {
+            s->error = load->ret;
+        } else if (load->error) {
+            Com_DPrintf("%s has %s\n", load->info.name, load->error);
+            s->error = Q_ERR_INVALID_FORMAT;
+        } else {
 #if USE_OPENAL
-    if (s_started == SS_OAL)
-        sc = AL_UploadSfx(s);
+            if (s_started == SS_OAL)
+                AL_UploadSfx(s, &load->info);
 #endif
-
 #if USE_SNDDMA
-    if (s_started == SS_DMA)
-        sc = ResampleSfx(s);
+            if (s_started == SS_DMA)
+                ResampleSfx(s, &load->info);
 #endif
+        }
+    }
 
-fail:
-    FS_FreeFile(data);
-    return sc;
+    if (load->detached)
+        free(load->data);
+    else
+        FS_FreeFile(load->data);
+    Z_Free(load);
+}
+
+static void load_work_cb(void *arg)
+{
+    S_RunLoad(arg);
+}
+
+static void load_done_cb(void *arg)
+{
+    soundload_t *load = arg;
+    sfx_t *s = load->sfx;
+
+    S_FinishLoad(load);
+    s_numloads--;
+
+    if (s)
+        S_ReleasePlaysounds(s);
+}
+
+/*
+==============
+S_QueueLoadSound
+
+Starts loading sound in background, unless it is already loaded.
+==============
+*/
+void S_QueueLoadSound(sfx_t *s)
+{
+    soundload_t *load = S_BeginLoad(s);
+
+    if (load) {
+        asyncwork_t work = {
+            .work_cb = load_work_cb,
+            .done_cb = load_done_cb,
+            .cb_arg = load,
+        };
+        Sys_QueueAsyncWork(&work);
+        s_numloads++;
+    }
+}
+
+/*
+==============
+S_CancelLoadSound
+
+Orphans pending load of the sound, if any. It will be discarded on completion.
+==============
+*/
+void S_CancelLoadSound(sfx_t *s)
+{
+    if (s->load) {
+        s->load->sfx = NULL;
+        s->load = NULL;
+    }
+}
+
+static void load_list_cb(void *arg, int index)
+{
+    soundload_t **loads = arg;
+
+    S_RunLoad(loads[index]);
+}
+
+// limits number of files open at once
+#define MAX_LOAD_BATCH  64
+
+/*
+==============
+S_LoadSoundList
+
+Loads the given sounds in parallel and waits for completion.
+==============
+*/
+void S_LoadSoundList(sfx_t **list, int count)
+{
+    soundload_t *loads[MAX_LOAD_BATCH];
+    int i, numloads;
+
+    while (count > 0) {
+        for (numloads = 0; count > 0 && numloads < MAX_LOAD_BATCH; list++, count--)
+            if ((loads[numloads] = S_BeginLoad(*list)))
+                numloads++;
+
+        Sys_ParallelFor(s_threads->integer, numloads, load_list_cb, loads);
+
+        for (i = 0; i < numloads; i++)
+            S_FinishLoad(loads[i]);
+    }
 }
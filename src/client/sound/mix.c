@@ -223,7 +223,8 @@ void S_PaintChannels(int endtime)
                 if (ch->end - ltime < count)
                     count = ch->end - ltime;
 
-                sc = S_LoadSound(ch->sfx);
+                // skip channels whose sound is not loaded yet
+                sc = ch->sfx->cache;
                 if (!sc)
                     break;
 
@@ -46,6 +46,7 @@ typedef struct sfx_s {
     sfxcache_t  *cache;
     char        *truename;
     int         error;
+    struct soundload_s  *load;  // pending background load
 } sfx_t;
 
 // a playsound_t will be generated by each call to S_StartSound,
@@ -114,7 +115,7 @@ void DMA_Update(void);
 void AL_SoundInfo(void);
 bool AL_Init(void);
 void AL_Shutdown(void);
-sfxcache_t *AL_UploadSfx(sfx_t *s);
+sfxcache_t *AL_UploadSfx(sfx_t *s, const wavinfo_t *info);
 void AL_DeleteSfx(sfx_t *s);
 void AL_StopChannel(channel_t *ch);
 void AL_PlayChannel(channel_t *ch);
@@ -155,8 +156,6 @@ extern  vec3_t      listener_right;
 extern  vec3_t      listener_up;
 extern  int         listener_entnum;
 
-extern  wavinfo_t   s_info;
-
 extern cvar_t   *s_volume;
 #if USE_SNDDMA
 extern cvar_t   *s_khz;
@@ -164,12 +163,18 @@ extern cvar_t   *s_testsound;
 #endif
 extern cvar_t   *s_ambient;
 extern cvar_t   *s_show;
+extern cvar_t   *s_threads;
+
+extern int      s_numloads;
 
 #define S_Malloc(x)     Z_TagMalloc(x, TAG_SOUND)
 #define S_CopyString(x) Z_TagCopyString(x, TAG_SOUND)
 
 sfx_t *S_SfxForHandle(qhandle_t hSfx);
-sfxcache_t *S_LoadSound(sfx_t *s);
+void S_QueueLoadSound(sfx_t *s);
+void S_CancelLoadSound(sfx_t *s);
+void S_LoadSoundList(sfx_t **list, int count);
+void S_ReleasePlaysounds(sfx_t *sfx);
 channel_t *S_PickChannel(int entnum, int entchannel);
 void S_IssuePlaysound(playsound_t *ps);
 void S_BuildSoundList(int *sounds);
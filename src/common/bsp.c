@@ -34,6 +34,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 extern mtexinfo_t nulltexinfo;
 
 static cvar_t *map_visibility_patch;
+static cvar_t *map_visibility_cache;
+
+static const byte   vis_none[VIS_MAX_BYTES];
+static byte         vis_all[VIS_MAX_BYTES];
 
 /*
 ===============================================================================
@@ -241,7 +245,6 @@ LOAD(Brushes)
         out->firstbrushside = bsp->brushsides + firstside;
         out->numsides = numsides;
         out->contents = LittleLong(in->contents);
-        out->checkcount = 0;
     }
 
     return Q_ERR_SUCCESS;
@@ -804,8 +807,9 @@ static void BSP_List_f(void)
     bytes = 0;
 
     LIST_FOR_EACH(bsp_t, bsp, &bsp_cache, entry) {
-        Com_Printf("%8zu : %s (%d refs)\n",
-                   bsp->hunk.mapped, bsp->name, bsp->refcount);
+        Com_Printf("%8zu : %s (%d refs%s)\n",
+                   bsp->hunk.mapped, bsp->name, bsp->refcount,
+                   bsp->visrows ? ", vis cached" : "");
         bytes += bsp->hunk.mapped;
     }
     Com_Printf("Total resident: %zu\n", bytes);
@@ -926,6 +930,8 @@ static int BSP_ValidateAreaPortals(bsp_t *bsp)
     return Q_ERR_SUCCESS;
 }
 
+static void BSP_BuildVisCache(bsp_t *bsp);
+
 void BSP_Free(bsp_t *bsp)
 {
     if (!bsp) {
@@ -935,6 +941,7 @@ void BSP_Free(bsp_t *bsp)
         Com_Error(ERR_FATAL, "%s: negative refcount", __func__);
     }
     if (--bsp->refcount == 0) {
+        Z_Free(bsp->visrows);
         Hunk_Free(&bsp->hunk);
         List_Remove(&bsp->entry);
         Z_Free(bsp);
@@ -979,7 +986,7 @@ int BSP_Load(const char *name, bsp_t **bsp_p)
     //
     // load the file
     //
-    filelen = FS_LoadFile(name, (void **)&buf);
+    filelen = FS_LoadFileEx(name, (void **)&buf, FS_FLAG_MAPPED, TAG_FILESYSTEM);
     if (!buf) {
         return filelen;
     }
@@ -1053,6 +1060,8 @@ int BSP_Load(const char *name, bsp_t **bsp_p)
 
     Hunk_End(&bsp->hunk);
 
+    BSP_BuildVisCache(bsp);
+
     List_Append(&bsp_cache, &bsp->entry);
 
     FS_FreeFile(buf);
@@ -1188,22 +1197,11 @@ void BSP_TransformedLightPoint(lightpoint_t *point, vec3_t start, vec3_t end,
 
 #endif
 
-byte *BSP_ClusterVis(bsp_t *bsp, byte *mask, int cluster, int vis)
+static void BSP_DecompressVis(bsp_t *bsp, byte *mask, int cluster, int vis)
 {
     byte    *in, *out, *in_end, *out_end;
     int     c;
 
-    if (!bsp || !bsp->vis) {
-        return memset(mask, 0xff, VIS_MAX_BYTES);
-    }
-    if (cluster == -1) {
-        return memset(mask, 0, bsp->visrowsize);
-    }
-    if (cluster < 0 || cluster >= bsp->vis->numclusters) {
-        Com_Error(ERR_DROP, "%s: bad cluster", __func__);
-    }
-
-    // decompress vis
     in_end = (byte *)bsp->vis + bsp->numvisibility;
     in = (byte *)bsp->vis + bsp->vis->bitofs[cluster][vis];
     out_end = mask + bsp->visrowsize;
@@ -1264,7 +1262,96 @@ overrun:
             }
         }
     }
+}
+
+// rows are padded to VIS_FAST_LONGS so that callers may safely read them as
+// size_t words, just like their own VIS_MAX_BYTES buffers
+#define VIS_ROW_STRIDE(bsp) \
+    (VIS_FAST_LONGS(bsp) * sizeof(size_t))
+
+#define VIS_ROW(bsp, cluster, vis) \
+    ((bsp)->visrows + ((cluster) * 2 + (vis)) * VIS_ROW_STRIDE(bsp))
+
+/*
+==================
+BSP_BuildVisCache
+
+Decompresses PVS and PHS rows for all clusters up front, if they fit into
+map_visibility_cache budget. Cache is filled once at load time and is
+read-only afterwards, so it is safe to access from worker threads.
+==================
+*/
+static void BSP_BuildVisCache(bsp_t *bsp)
+{
+    size_t  size, limit;
+    int     i;
+
+    if (!bsp->vis || !bsp->vis->numclusters) {
+        return;
+    }
+    if (map_visibility_cache->integer <= 0) {
+        return;
+    }
+
+    size = bsp->vis->numclusters * 2 * VIS_ROW_STRIDE(bsp);
+    limit = (size_t)map_visibility_cache->integer << 20;
+    if (size > limit) {
+        Com_DPrintf("%s: %zu bytes needed to cache %s vis, limit is %zu\n",
+                    __func__, size, bsp->name, limit);
+        return;
+    }
 
+    bsp->visrows = Z_Mallocz(size);
+    for (i = 0; i < bsp->vis->numclusters; i++) {
+        BSP_DecompressVis(bsp, VIS_ROW(bsp, i, DVIS_PVS), i, DVIS_PVS);
+        BSP_DecompressVis(bsp, VIS_ROW(bsp, i, DVIS_PHS), i, DVIS_PHS);
+    }
+}
+
+/*
+==================
+BSP_GetClusterVis
+
+Returns PVS or PHS row for the given cluster. If the row is cached, pointer
+to the cached row is returned and mask is left untouched. Otherwise, the row
+is decompressed into mask. Returned row must not be modified.
+==================
+*/
+const byte *BSP_GetClusterVis(bsp_t *bsp, byte *mask, int cluster, int vis)
+{
+    if (!bsp || !bsp->vis) {
+        return vis_all;
+    }
+    if (cluster == -1) {
+        return vis_none;
+    }
+    if (cluster < 0 || cluster >= bsp->vis->numclusters) {
+        Com_Error(ERR_DROP, "%s: bad cluster", __func__);
+    }
+    if (bsp->visrows) {
+        return VIS_ROW(bsp, cluster, vis);
+    }
+
+    BSP_DecompressVis(bsp, mask, cluster, vis);
+    return mask;
+}
+
+byte *BSP_ClusterVis(bsp_t *bsp, byte *mask, int cluster, int vis)
+{
+    if (!bsp || !bsp->vis) {
+        return memset(mask, 0xff, VIS_MAX_BYTES);
+    }
+    if (cluster == -1) {
+        return memset(mask, 0, bsp->visrowsize);
+    }
+    if (cluster < 0 || cluster >= bsp->vis->numclusters) {
+        Com_Error(ERR_DROP, "%s: bad cluster", __func__);
+    }
+    if (bsp->visrows) {
+        return memcpy(mask, VIS_ROW(bsp, cluster, vis), bsp->visrowsize);
+    }
+
+    BSP_DecompressVis(bsp, mask, cluster, vis);
     return mask;
 }
 
@@ -1309,8 +1396,11 @@ mmodel_t *BSP_InlineModel(bsp_t *bsp, const char *name)
 void BSP_Init(void)
 {
     map_visibility_patch = Cvar_Get("map_visibility_patch", "1", 0);
+    map_visibility_cache = Cvar_Get("map_visibility_cache", "16", 0);
 
     Cmd_AddCommand("bsplist", BSP_List_f);
 
+    memset(vis_all, 0xff, sizeof(vis_all));
+
     List_Init(&bsp_cache);
 }
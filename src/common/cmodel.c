@@ -32,7 +32,6 @@ mtexinfo_t nulltexinfo;
 static mleaf_t      nullleaf;
 
 static int          floodvalid;
-static int          checkcount;
 
 static cvar_t       *map_noareas;
 static cvar_t       *map_allsolid_bug;
@@ -214,53 +213,57 @@ CM_BoxLeafnums
 Fills in a list of all the leafs touched
 =============
 */
-static int      leaf_count, leaf_maxcount;
-static mleaf_t  **leaf_list;
-static float    *leaf_mins, *leaf_maxs;
-static mnode_t  *leaf_topnode;
-
-static void CM_BoxLeafs_r(mnode_t *node)
+typedef struct {
+    int         count, maxcount;
+    mleaf_t     **list;
+    float       *mins, *maxs;
+    mnode_t     *topnode;
+} boxleafs_t;
+
+static void CM_BoxLeafs_r(boxleafs_t *bl, mnode_t *node)
 {
     int     s;
 
     while (node->plane) {
-        s = BoxOnPlaneSideFast(leaf_mins, leaf_maxs, node->plane);
+        s = BoxOnPlaneSideFast(bl->mins, bl->maxs, node->plane);
         if (s == 1) {
             node = node->children[0];
         } else if (s == 2) {
             node = node->children[1];
         } else {
             // go down both
-            if (!leaf_topnode) {
-                leaf_topnode = node;
+            if (!bl->topnode) {
+                bl->topnode = node;
             }
-            CM_BoxLeafs_r(node->children[0]);
+            CM_BoxLeafs_r(bl, node->children[0]);
             node = node->children[1];
         }
     }
 
-    if (leaf_count < leaf_maxcount) {
-        leaf_list[leaf_count++] = (mleaf_t *)node;
+    if (bl->count < bl->maxcount) {
+        bl->list[bl->count++] = (mleaf_t *)node;
     }
 }
 
 static int CM_BoxLeafs_headnode(vec3_t mins, vec3_t maxs, mleaf_t **list, int listsize,
                                 mnode_t *headnode, mnode_t **topnode)
 {
-    leaf_list = list;
-    leaf_count = 0;
-    leaf_maxcount = listsize;
-    leaf_mins = mins;
-    leaf_maxs = maxs;
+    boxleafs_t  bl;
+
+    bl.list = list;
+    bl.count = 0;
+    bl.maxcount = listsize;
+    bl.mins = mins;
+    bl.maxs = maxs;
 
-    leaf_topnode = NULL;
+    bl.topnode = NULL;
 
-    CM_BoxLeafs_r(headnode);
+    CM_BoxLeafs_r(&bl, headnode);
 
     if (topnode)
-        *topnode = leaf_topnode;
+        *topnode = bl.topnode;
 
-    return leaf_count;
+    return bl.count;
 }
 
 int CM_BoxLeafs(cm_t *cm, vec3_t mins, vec3_t maxs, mleaf_t **list, int listsize, mnode_t **topnode)
@@ -322,20 +325,42 @@ BOX TRACING
 // 1/32 epsilon to keep floating point happy
 #define DIST_EPSILON    0.03125f
 
-static vec3_t   trace_start, trace_end;
-static vec3_t   trace_offsets[8];
-static vec3_t   trace_extents;
+/*
+================
+CM_CheckBrush
+
+Returns true if brush was already tested by this trace in another leaf.
+Brush pointers are kept in a small open addressing hash set. When the set
+fills up, remaining brushes are simply tested again, which doesn't change
+the result. Used slots are remembered so that the next trace clears only
+those.
+================
+*/
+static bool CM_CheckBrush(cm_trace_t *ctx, mbrush_t *brush)
+{
+    unsigned    i;
+
+    i = ((uint32_t)((uintptr_t)brush >> 3) * 0x9e3779b1U) >> (32 - CM_TRACE_BRUSHES_BITS);
+    while (ctx->checked[i]) {
+        if (ctx->checked[i] == brush)
+            return true;
+        i = (i + 1) & (CM_TRACE_BRUSHES - 1);
+    }
+
+    if (ctx->numchecked < CM_TRACE_CHECKED) {
+        ctx->checked[i] = brush;
+        ctx->checkedslots[ctx->numchecked++] = i;
+    }
 
-static trace_t  *trace_trace;
-static int      trace_contents;
-static bool     trace_ispoint;      // optimized case
+    return false;
+}
 
 /*
 ================
 CM_ClipBoxToBrush
 ================
 */
-static void CM_ClipBoxToBrush(vec3_t p1, vec3_t p2, trace_t *trace, mbrush_t *brush)
+static void CM_ClipBoxToBrush(cm_trace_t *ctx, vec3_t p1, vec3_t p2, trace_t *trace, mbrush_t *brush)
 {
     int         i;
     cplane_t    *plane, *clipplane;
@@ -362,10 +387,10 @@ static void CM_ClipBoxToBrush(vec3_t p1, vec3_t p2, trace_t *trace, mbrush_t *br
         plane = side->plane;
 
         // FIXME: special case for axial
-        if (!trace_ispoint) {
+        if (!ctx->ispoint) {
             // general box case
             // push the plane out apropriately for mins/maxs
-            dist = DotProduct(trace_offsets[plane->signbits], plane->normal);
+            dist = DotProduct(ctx->offsets[plane->signbits], plane->normal);
             dist = plane->dist - dist;
         } else {
             // special point case
@@ -434,7 +459,7 @@ static void CM_ClipBoxToBrush(vec3_t p1, vec3_t p2, trace_t *trace, mbrush_t *br
 CM_TestBoxInBrush
 ================
 */
-static void CM_TestBoxInBrush(vec3_t p1, trace_t *trace, mbrush_t *brush)
+static void CM_TestBoxInBrush(cm_trace_t *ctx, vec3_t p1, trace_t *trace, mbrush_t *brush)
 {
     int         i;
     cplane_t    *plane;
@@ -452,7 +477,7 @@ static void CM_TestBoxInBrush(vec3_t p1, trace_t *trace, mbrush_t *brush)
         // FIXME: special case for axial
         // general box case
         // push the plane out apropriately for mins/maxs
-        dist = DotProduct(trace_offsets[plane->signbits], plane->normal);
+        dist = DotProduct(ctx->offsets[plane->signbits], plane->normal);
         dist = plane->dist - dist;
 
         d1 = DotProduct(p1, plane->normal) - dist;
@@ -473,25 +498,24 @@ static void CM_TestBoxInBrush(vec3_t p1, trace_t *trace, mbrush_t *brush)
 CM_TraceToLeaf
 ================
 */
-static void CM_TraceToLeaf(mleaf_t *leaf)
+static void CM_TraceToLeaf(cm_trace_t *ctx, mleaf_t *leaf)
 {
     int         k;
     mbrush_t    *b, **leafbrush;
 
-    if (!(leaf->contents & trace_contents))
+    if (!(leaf->contents & ctx->contents))
         return;
     // trace line against all brushes in the leaf
     leafbrush = leaf->firstleafbrush;
     for (k = 0; k < leaf->numleafbrushes; k++, leafbrush++) {
         b = *leafbrush;
-        if (b->checkcount == checkcount)
+        if (CM_CheckBrush(ctx, b))
             continue;   // already checked this brush in another leaf
-        b->checkcount = checkcount;
 
-        if (!(b->contents & trace_contents))
+        if (!(b->contents & ctx->contents))
             continue;
-        CM_ClipBoxToBrush(trace_start, trace_end, trace_trace, b);
-        if (!trace_trace->fraction)
+        CM_ClipBoxToBrush(ctx, ctx->start, ctx->end, ctx->trace, b);
+        if (!ctx->trace->fraction)
             return;
     }
 }
@@ -501,25 +525,24 @@ static void CM_TraceToLeaf(mleaf_t *leaf)
 CM_TestInLeaf
 ================
 */
-static void CM_TestInLeaf(mleaf_t *leaf)
+static void CM_TestInLeaf(cm_trace_t *ctx, mleaf_t *leaf)
 {
     int         k;
     mbrush_t    *b, **leafbrush;
 
-    if (!(leaf->contents & trace_contents))
+    if (!(leaf->contents & ctx->contents))
         return;
     // trace line against all brushes in the leaf
     leafbrush = leaf->firstleafbrush;
     for (k = 0; k < leaf->numleafbrushes; k++, leafbrush++) {
         b = *leafbrush;
-        if (b->checkcount == checkcount)
+        if (CM_CheckBrush(ctx, b))
             continue;   // already checked this brush in another leaf
-        b->checkcount = checkcount;
 
-        if (!(b->contents & trace_contents))
+        if (!(b->contents & ctx->contents))
             continue;
-        CM_TestBoxInBrush(trace_start, trace_trace, b);
-        if (!trace_trace->fraction)
+        CM_TestBoxInBrush(ctx, ctx->start, ctx->trace, b);
+        if (!ctx->trace->fraction)
             return;
     }
 }
@@ -530,7 +553,7 @@ CM_RecursiveHullCheck
 
 ==================
 */
-static void CM_RecursiveHullCheck(mnode_t *node, float p1f, float p2f, vec3_t p1, vec3_t p2)
+static void CM_RecursiveHullCheck(cm_trace_t *ctx, mnode_t *node, float p1f, float p2f, vec3_t p1, vec3_t p2)
 {
     cplane_t    *plane;
     float       t1, t2, offset;
@@ -540,14 +563,14 @@ static void CM_RecursiveHullCheck(mnode_t *node, float p1f, float p2f, vec3_t p1
     int         side;
     float       midf;
 
-    if (trace_trace->fraction <= p1f)
+    if (ctx->trace->fraction <= p1f)
         return;     // already hit something nearer
 
 recheck:
     // if plane is NULL, we are in a leaf node
     plane = node->plane;
     if (!plane) {
-        CM_TraceToLeaf((mleaf_t *)node);
+        CM_TraceToLeaf(ctx, (mleaf_t *)node);
         return;
     }
 
@@ -558,16 +581,16 @@ recheck:
     if (plane->type < 3) {
         t1 = p1[plane->type] - plane->dist;
         t2 = p2[plane->type] - plane->dist;
-        offset = trace_extents[plane->type];
+        offset = ctx->extents[plane->type];
     } else {
         t1 = PlaneDiff(p1, plane);
         t2 = PlaneDiff(p2, plane);
-        if (trace_ispoint)
+        if (ctx->ispoint)
             offset = 0;
         else
-            offset = fabsf(trace_extents[0] * plane->normal[0]) +
-                     fabsf(trace_extents[1] * plane->normal[1]) +
-                     fabsf(trace_extents[2] * plane->normal[2]);
+            offset = fabsf(ctx->extents[0] * plane->normal[0]) +
+                     fabsf(ctx->extents[1] * plane->normal[1]) +
+                     fabsf(ctx->extents[2] * plane->normal[2]);
     }
 
     // see which sides we need to consider
@@ -601,47 +624,55 @@ recheck:
     midf = p1f + (p2f - p1f) * clamp(frac, 0, 1);
     LerpVector(p1, p2, frac, mid);
 
-    CM_RecursiveHullCheck(node->children[side], p1f, midf, p1, mid);
+    CM_RecursiveHullCheck(ctx, node->children[side], p1f, midf, p1, mid);
 
     // go past the node
     midf = p1f + (p2f - p1f) * clamp(frac2, 0, 1);
     LerpVector(p1, p2, frac2, mid);
 
-    CM_RecursiveHullCheck(node->children[side ^ 1], midf, p2f, mid, p2);
+    CM_RecursiveHullCheck(ctx, node->children[side ^ 1], midf, p2f, mid, p2);
 }
 
 //======================================================================
 
 /*
 ==================
-CM_BoxTrace
+CM_BoxTraceCtx
+
+Reentrant version of CM_BoxTrace. All state is kept in caller supplied
+context, so traces may run concurrently as long as BSP is not modified
+and each thread uses its own context.
 ==================
 */
-void CM_BoxTrace(trace_t *trace, vec3_t start, vec3_t end,
-                 vec3_t mins, vec3_t maxs,
-                 mnode_t *headnode, int brushmask)
+void CM_BoxTraceCtx(cm_trace_t *ctx, trace_t *trace,
+                    vec3_t start, vec3_t end,
+                    vec3_t mins, vec3_t maxs,
+                    mnode_t *headnode, int brushmask)
 {
     vec_t *bounds[2] = { mins, maxs };
     int i, j;
 
-    checkcount++;       // for multi-check avoidance
+    // for multi-check avoidance
+    for (i = 0; i < ctx->numchecked; i++)
+        ctx->checked[ctx->checkedslots[i]] = NULL;
+    ctx->numchecked = 0;
 
     // fill in a default trace
-    trace_trace = trace;
-    memset(trace_trace, 0, sizeof(*trace_trace));
-    trace_trace->fraction = 1;
-    trace_trace->surface = &(nulltexinfo.c);
+    ctx->trace = trace;
+    memset(ctx->trace, 0, sizeof(*ctx->trace));
+    ctx->trace->fraction = 1;
+    ctx->trace->surface = &(nulltexinfo.c);
 
     if (!headnode) {
         return;
     }
 
-    trace_contents = brushmask;
-    VectorCopy(start, trace_start);
-    VectorCopy(end, trace_end);
+    ctx->contents = brushmask;
+    VectorCopy(start, ctx->start);
+    VectorCopy(end, ctx->end);
     for (i = 0; i < 8; i++)
         for (j = 0; j < 3; j++)
-            trace_offsets[i][j] = bounds[i >> j & 1][j];
+            ctx->offsets[i][j] = bounds[i >> j & 1][j];
 
     //
     // check for position test special case
@@ -660,11 +691,11 @@ void CM_BoxTrace(trace_t *trace, vec3_t start, vec3_t end,
 
         numleafs = CM_BoxLeafs_headnode(c1, c2, leafs, q_countof(leafs), headnode, NULL);
         for (i = 0; i < numleafs; i++) {
-            CM_TestInLeaf(leafs[i]);
-            if (trace_trace->allsolid)
+            CM_TestInLeaf(ctx, leafs[i]);
+            if (ctx->trace->allsolid)
                 break;
         }
-        VectorCopy(start, trace_trace->endpos);
+        VectorCopy(start, ctx->trace->endpos);
         return;
     }
 
@@ -672,24 +703,39 @@ void CM_BoxTrace(trace_t *trace, vec3_t start, vec3_t end,
     // check for point special case
     //
     if (VectorEmpty(mins) && VectorEmpty(maxs)) {
-        trace_ispoint = true;
-        VectorClear(trace_extents);
+        ctx->ispoint = true;
+        VectorClear(ctx->extents);
     } else {
-        trace_ispoint = false;
-        trace_extents[0] = max(-mins[0], maxs[0]);
-        trace_extents[1] = max(-mins[1], maxs[1]);
-        trace_extents[2] = max(-mins[2], maxs[2]);
+        ctx->ispoint = false;
+        ctx->extents[0] = max(-mins[0], maxs[0]);
+        ctx->extents[1] = max(-mins[1], maxs[1]);
+        ctx->extents[2] = max(-mins[2], maxs[2]);
     }
 
     //
     // general sweeping through world
     //
-    CM_RecursiveHullCheck(headnode, 0, 1, start, end);
+    CM_RecursiveHullCheck(ctx, headnode, 0, 1, start, end);
 
-    if (trace_trace->fraction == 1)
-        VectorCopy(end, trace_trace->endpos);
+    if (ctx->trace->fraction == 1)
+        VectorCopy(end, ctx->trace->endpos);
     else
-        LerpVector(start, end, trace_trace->fraction, trace_trace->endpos);
+        LerpVector(start, end, ctx->trace->fraction, ctx->trace->endpos);
+}
+
+// context for non-reentrant versions
+static cm_trace_t   cm_trace;
+
+/*
+==================
+CM_BoxTrace
+==================
+*/
+void CM_BoxTrace(trace_t *trace, vec3_t start, vec3_t end,
+                 vec3_t mins, vec3_t maxs,
+                 mnode_t *headnode, int brushmask)
+{
+    CM_BoxTraceCtx(&cm_trace, trace, start, end, mins, maxs, headnode, brushmask);
 }
 
 /*
@@ -700,10 +746,11 @@ Handles offseting and rotation of the end points for moving and
 rotating entities
 ==================
 */
-void CM_TransformedBoxTrace(trace_t *trace, vec3_t start, vec3_t end,
-                            vec3_t mins, vec3_t maxs,
-                            mnode_t *headnode, int brushmask,
-                            vec3_t origin, vec3_t angles)
+void CM_TransformedBoxTraceCtx(cm_trace_t *ctx, trace_t *trace,
+                               vec3_t start, vec3_t end,
+                               vec3_t mins, vec3_t maxs,
+                               mnode_t *headnode, int brushmask,
+                               vec3_t origin, vec3_t angles)
 {
     vec3_t      start_l, end_l;
     vec3_t      axis[3];
@@ -722,7 +769,7 @@ void CM_TransformedBoxTrace(trace_t *trace, vec3_t start, vec3_t end,
     }
 
     // sweep the box through the model
-    CM_BoxTrace(trace, start_l, end_l, mins, maxs, headnode, brushmask);
+    CM_BoxTraceCtx(ctx, trace, start_l, end_l, mins, maxs, headnode, brushmask);
 
     // rotate plane normal into the worlds frame of reference
     if (rotated && trace->fraction != 1.0f) {
@@ -735,6 +782,15 @@ void CM_TransformedBoxTrace(trace_t *trace, vec3_t start, vec3_t end,
     LerpVector(start, end, trace->fraction, trace->endpos);
 }
 
+void CM_TransformedBoxTrace(trace_t *trace, vec3_t start, vec3_t end,
+                            vec3_t mins, vec3_t maxs,
+                            mnode_t *headnode, int brushmask,
+                            vec3_t origin, vec3_t angles)
+{
+    CM_TransformedBoxTraceCtx(&cm_trace, trace, start, end, mins, maxs,
+                              headnode, brushmask, origin, angles);
+}
+
 void CM_ClipEntity(trace_t *dst, const trace_t *src, struct edict_s *ent)
 {
     dst->allsolid |= src->allsolid;
@@ -966,7 +1022,8 @@ byte *CM_FatPVS(cm_t *cm, byte *mask, const vec3_t org)
     mleaf_t *leafs[64];
     int     clusters[64];
     int     i, j, count, longs;
-    size_t  *src, *dst;
+    const size_t *src;
+    size_t  *dst;
     vec3_t  mins, maxs;
 
     if (!cm->cache) {   // map not loaded
@@ -1000,7 +1057,7 @@ byte *CM_FatPVS(cm_t *cm, byte *mask, const vec3_t org)
                 goto nextleaf; // already have the cluster we want
             }
         }
-        src = (size_t *)BSP_ClusterVis(cm->cache, temp, clusters[i], DVIS_PVS);
+        src = (const size_t *)BSP_GetClusterVis(cm->cache, temp, clusters[i], DVIS_PVS);
         dst = (size_t *)mask;
         for (j = 0; j < longs; j++) {
             *dst++ |= *src++;
@@ -1023,9 +1023,11 @@ void Qcommon_Init(int argc, char **argv)
     // even not given a starting map, dedicated server starts
     // listening for rcon commands (create socket after all configs
     // are executed to make sure port number is properly set)
+#if !USE_LOADGEN
     if (COM_DEDICATED) {
         NET_Config(NET_SERVER);
     }
+#endif
 
     Com_AddConfigFile(COM_POSTINIT_CFG, FS_TYPE_REAL);
 
@@ -30,6 +30,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <fcntl.h>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
 #if USE_ZLIB
 #include <zlib.h>
 #endif
@@ -123,6 +127,9 @@ typedef struct {
     filetype_t  type;       // FS_PAK or FS_ZIP
     unsigned    refcount;   // for tracking pack users
     FILE        *fp;
+    list_t      entry;      // in fs_mapped_packs if mapped
+    byte        *map;       // read-only mapping of entire file, or NULL
+    size_t      mapsize;
     unsigned    num_files;
     unsigned    hash_size;
     packfile_t  *files;
@@ -171,6 +178,22 @@ static searchpath_t *fs_base_searchpaths;
 static list_t       fs_hard_links;
 static list_t       fs_soft_links;
 
+// packs currently mapped into memory
+static list_t       fs_mapped_packs;
+
+// merged index of all files in the search path
+typedef struct pathnode_s {
+    struct pathnode_s   *hash_next;
+    pack_t      *pack;      // highest priority pack the file is in
+    packfile_t  *entry;     // NULL if the file may be found on disk
+    unsigned    namelen;
+    char        name[1];
+} pathnode_t;
+
+static pathnode_t   **fs_index_hash;
+static unsigned     fs_index_size;
+static bool         fs_index_complete;  // no directory listing was truncated
+
 static file_t       fs_files[MAX_FILE_HANDLES];
 
 #ifdef _DEBUG
@@ -193,6 +216,9 @@ static int          fs_count_strlwr;
 static cvar_t       *fs_debug;
 #endif
 
+static cvar_t       *fs_mmap;
+static cvar_t       *fs_index;
+
 cvar_t              *fs_game;
 
 #if USE_ZLIB
@@ -210,6 +236,8 @@ static int read_zip_file(file_t *file, void *buf, size_t len);
 static pack_t *pack_get(pack_t *pack);
 static void pack_put(pack_t *pack);
 
+static void index_file_created(const char *normalized);
+
 /*
 
 All of Quake's data access is through a hierchal file system,
@@ -910,6 +938,8 @@ static int64_t open_file_write(file_t *file, const char *name)
         goto fail;
     }
 
+    index_file_created(normalized);
+
     FS_DPrintf("%s: %s: %"PRId64" bytes\n", __func__, fullpath, pos);
     return pos;
 
@@ -1259,6 +1289,193 @@ fail:
     return ret;
 }
 
+/*
+=============================================================================
+
+PATH INDEX
+
+Remembers every file found in pack files and directory trees of the search
+path at the time of first lookup. Paths missing from the index don't exist,
+paths found in packs are opened directly, and only paths found on disk fall
+back to walking the search path. So do paths that directory listing skips
+(dotfiles, deep paths). Files created by the filesystem itself are added as
+they are written, downloaded files are added with FS_FileCreated, anything
+else requires FS_FlushIndex.
+
+=============================================================================
+*/
+
+static pathnode_t *index_find(const char *name, size_t namelen, unsigned hash)
+{
+    pathnode_t *node;
+
+    for (node = fs_index_hash[hash & (fs_index_size - 1)]; node; node = node->hash_next) {
+        if (node->namelen == namelen && !FS_pathcmp(node->name, name)) {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+static pathnode_t *index_add(const char *name, size_t namelen, pack_t *pack, packfile_t *entry)
+{
+    pathnode_t *node;
+    unsigned hash;
+
+    hash = FS_HashPath(name, 0);
+    node = index_find(name, namelen, hash);
+    if (node) {
+        return node;    // higher priority copy already indexed
+    }
+
+    node = FS_Malloc(sizeof(*node) + namelen);
+    node->pack = pack;
+    node->entry = entry;
+    node->namelen = namelen;
+    memcpy(node->name, name, namelen + 1);
+
+    hash &= fs_index_size - 1;
+    node->hash_next = fs_index_hash[hash];
+    fs_index_hash[hash] = node;
+
+    return node;
+}
+
+static void build_index(void)
+{
+    searchpath_t    *search;
+    listfiles_t     *lists, *list;
+    pack_t          *pack;
+    unsigned        i, j, total, numpaths;
+    size_t          len;
+    char            *name;
+
+    numpaths = 0;
+    for (search = fs_searchpaths; search; search = search->next) {
+        numpaths++;
+    }
+
+    // list directory trees first to find out total number of files
+    lists = FS_Mallocz(sizeof(*lists) * numpaths);
+    total = 0;
+    fs_index_complete = true;
+    for (search = fs_searchpaths, list = lists; search; search = search->next, list++) {
+        if (search->pack) {
+            total += search->pack->num_files;
+            continue;
+        }
+        list->filter = "*";
+        list->flags = FS_SEARCH_BYFILTER | FS_SEARCH_SAVEPATH;
+        list->baselen = strlen(search->filename) + 1;
+        Sys_ListFiles_r(list, search->filename, 0);
+        if (list->count >= MAX_LISTED_FILES)
+            fs_index_complete = false;
+        total += list->count;
+    }
+
+    fs_index_size = npot32(max(total / 2, 64));
+    fs_index_hash = FS_Mallocz(sizeof(fs_index_hash[0]) * fs_index_size);
+
+    // add files in search order, so that the first copy wins
+    for (search = fs_searchpaths, list = lists; search; search = search->next, list++) {
+        pack = search->pack;
+        if (pack) {
+            for (i = 0; i < pack->num_files; i++) {
+                index_add(pack->files[i].name, pack->files[i].namelen, pack, &pack->files[i]);
+            }
+            continue;
+        }
+        for (j = 0; j < list->count; j++) {
+            name = list->files[j];
+            len = FS_NormalizePath(name, name);
+            index_add(name, len, NULL, NULL);
+            Z_Free(name);
+        }
+        Z_Free(list->files);
+    }
+
+    Z_Free(lists);
+
+    FS_DPrintf("%s: %u files\n", __func__, total);
+}
+
+/*
+================
+FS_FlushIndex
+
+Forgets about indexed files. Index will be rebuilt on next lookup.
+================
+*/
+void FS_FlushIndex(void)
+{
+    pathnode_t *node, *next;
+    unsigned i;
+
+    if (!fs_index_hash) {
+        return;
+    }
+
+    for (i = 0; i < fs_index_size; i++) {
+        for (node = fs_index_hash[i]; node; node = next) {
+            next = node->hash_next;
+            Z_Free(node);
+        }
+    }
+
+    Z_Free(fs_index_hash);
+    fs_index_hash = NULL;
+    fs_index_size = 0;
+}
+
+// makes sure newly created file is not reported missing
+static void index_file_created(const char *normalized)
+{
+    pathnode_t *node;
+
+    if (fs_index_hash) {
+        node = index_add(normalized, strlen(normalized), NULL, NULL);
+        node->pack = NULL;
+        node->entry = NULL;
+    }
+}
+
+/*
+================
+FS_FileCreated
+
+Adds file created outside of filesystem to the index.
+================
+*/
+void FS_FileCreated(const char *path)
+{
+    char normalized[MAX_OSPATH];
+
+    if (fs_index_hash && FS_NormalizePathBuffer(normalized, path, MAX_OSPATH) < MAX_OSPATH) {
+        index_file_created(normalized);
+    }
+}
+
+// returns true if directory listing would have found the path,
+// so that missing it from the index means it doesn't exist
+static bool index_path_listed(const char *normalized)
+{
+    const char *s;
+    int depth = 0;
+
+    if (!fs_index_complete || *normalized == '.') {
+        return false;
+    }
+
+    for (s = normalized; *s; s++) {
+        if (*s == '/' && (s[1] == '.' || ++depth > MAX_LISTED_DEPTH)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 // Finds the file in the search path.
 // Fills file_t and returns file length.
 // Used for streaming data out of either a pak file or a seperate file.
@@ -1269,6 +1486,7 @@ static int64_t open_file_read(file_t *file, const char *normalized, size_t namel
     pack_t          *pak;
     unsigned        hash;
     packfile_t      *entry;
+    pathnode_t      *node;
     int64_t         ret;
     int             valid;
 
@@ -1276,6 +1494,21 @@ static int64_t open_file_read(file_t *file, const char *normalized, size_t namel
 
     hash = FS_HashPath(normalized, 0);
 
+    // consult the index unless searching in specific paths
+    if (fs_index->integer && !(file->mode & (FS_TYPE_MASK | FS_PATH_MASK | FS_FLAG_DEFLATE))) {
+        if (!fs_index_hash) {
+            build_index();
+        }
+        node = index_find(normalized, namelen, hash);
+        if (!node && index_path_listed(normalized)) {
+            ret = FS_ValidatePath(normalized) ? Q_ERR_NOENT : Q_ERR_INVALID_PATH;
+            goto fail;
+        }
+        if (node && node->entry) {
+            return open_from_pak(file, node->pack, node->entry, unique);
+        }
+    }
+
     valid = PATH_NOT_CHECKED;
 
 // search through the path, one element at a time
@@ -1628,6 +1861,61 @@ int64_t FS_FOpenFile(const char *name, qhandle_t *f, unsigned mode)
     return ret;
 }
 
+/*
+============
+FS_OpenDetached
+
+Opens file for reading like FS_FOpenFile, but returns the underlying stdio
+stream positioned at start of file data instead of a handle. The stream is
+not tracked by filesystem, so it may be read from another thread. Caller
+must read no more than returned length and close it with fclose(). Files
+that need decompression can't be detached and return Q_ERR_NOSYS.
+============
+*/
+int64_t FS_OpenDetached(const char *name, FILE **fp)
+{
+    file_t *file;
+    qhandle_t f;
+    int64_t ret;
+
+    if (!name || !fp) {
+        Com_Error(ERR_FATAL, "%s: NULL", __func__);
+    }
+
+    *fp = NULL;
+
+    if (!fs_searchpaths) {
+        return Q_ERR_AGAIN; // not yet initialized
+    }
+
+    // allocate new file handle
+    file = alloc_handle(&f);
+    if (!file) {
+        return Q_ERR_MFILE;
+    }
+
+    file->mode = FS_MODE_READ;
+
+    ret = expand_open_file_read(file, name, true);
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (file->type != FS_REAL && file->type != FS_PAK) {
+        FS_FCloseFile(f);
+        return Q_ERR_NOSYS;
+    }
+
+    // stream was opened privately, pack stays referenced by search path
+    if (file->type == FS_PAK) {
+        pack_put(file->pack);
+    }
+
+    *fp = file->fp;
+    memset(file, 0, sizeof(*file));
+    return ret;
+}
+
 // reading from outside of source directory is allowed, extension is optional
 static qhandle_t easy_open_read(char *buf, size_t size, unsigned mode,
                                 const char *dir, const char *name, const char *ext)
@@ -1750,6 +2038,11 @@ FS_LoadFile
 
 opens non-unique file handle as an optimization
 a NULL buffer will just return the file length without loading
+
+if FS_FLAG_MAPPED is set and the file is stored uncompressed and 4 byte
+aligned in a mapped pack, returns read-only view into the mapping instead
+of a copy. Such a buffer is not NUL terminated. In either case buffer must
+be released with FS_FreeFile.
 ============
 */
 int FS_LoadFileEx(const char *path, void **buffer, unsigned flags, memtag_t tag)
@@ -1797,6 +2090,16 @@ int FS_LoadFileEx(const char *path, void **buffer, unsigned flags, memtag_t tag)
         goto done;
     }
 
+    // return view into mapped pack without copying. callers cast file
+    // contents to structures, so unaligned files are still copied
+    if ((flags & FS_FLAG_MAPPED) && file->type == FS_PAK && file->pack->map &&
+        !(file->entry->filepos & 3) &&
+        file->entry->filepos + len <= file->pack->mapsize) {
+        *buffer = file->pack->map + file->entry->filepos;
+        pack_get(file->pack);
+        goto done;
+    }
+
     // allocate chunk of memory, +1 for NUL
     buf = Z_TagMalloc(len + 1, tag);
 
@@ -1816,6 +2119,31 @@ done:
     return len;
 }
 
+/*
+============
+FS_FreeFile
+
+Frees buffer returned by FS_LoadFile.
+============
+*/
+void FS_FreeFile(void *buf)
+{
+    pack_t *pack;
+
+    if (!buf) {
+        return;
+    }
+
+    LIST_FOR_EACH(pack_t, pack, &fs_mapped_packs, entry) {
+        if ((byte *)buf >= pack->map && (byte *)buf < pack->map + pack->mapsize) {
+            pack_put(pack);
+            return;
+        }
+    }
+
+    Z_Free(buf);
+}
+
 static int write_and_close(const void *data, size_t len, qhandle_t f)
 {
     int ret1 = FS_Write(data, len, f);
@@ -1911,6 +2239,7 @@ int FS_RenameFile(const char *from, const char *to)
     if (rename(frompath, topath))
         return Q_ERRNO;
 
+    FS_FileCreated(to);
     return Q_ERR_SUCCESS;
 }
 
@@ -1938,6 +2267,52 @@ int FS_FPrintf(qhandle_t f, const char *format, ...)
     return FS_Write(string, len, f);
 }
 
+// maps entire pack into memory, allowing zero-copy loads of stored files
+static void pack_map(pack_t *pack)
+{
+#ifndef _WIN32
+    file_info_t info;
+    void *map;
+    int ret;
+
+    ret = get_fp_info(pack->fp, &info);
+    if (ret) {
+        goto fail;
+    }
+
+    if (info.size <= 0 || info.size > SIZE_MAX) {
+        ret = Q_ERR_FBIG;
+        goto fail;
+    }
+
+    map = mmap(NULL, info.size, PROT_READ, MAP_SHARED, os_fileno(pack->fp), 0);
+    if (map == MAP_FAILED) {
+        ret = Q_ERRNO;
+        goto fail;
+    }
+
+    pack->map = map;
+    pack->mapsize = info.size;
+    List_Append(&fs_mapped_packs, &pack->entry);
+    return;
+
+fail:
+    Com_WPrintf("Couldn't map %s: %s\n", pack->filename, Q_ErrorString(ret));
+#endif
+}
+
+static void pack_unmap(pack_t *pack)
+{
+#ifndef _WIN32
+    if (pack->map) {
+        munmap(pack->map, pack->mapsize);
+        List_Remove(&pack->entry);
+        pack->map = NULL;
+        pack->mapsize = 0;
+    }
+#endif
+}
+
 // references pack_t instance
 static pack_t *pack_get(pack_t *pack)
 {
@@ -1956,6 +2331,7 @@ static void pack_put(pack_t *pack)
     }
     if (!--pack->refcount) {
         FS_DPrintf("Freeing packfile %s\n", pack->filename);
+        pack_unmap(pack);
         fclose(pack->fp);
         Z_Free(pack);
     }
@@ -1979,6 +2355,8 @@ static pack_t *pack_alloc(FILE *fp, filetype_t type, const char *name,
     pack->type = type;
     pack->refcount = 0;
     pack->fp = fp;
+    pack->map = NULL;
+    pack->mapsize = 0;
     pack->num_files = num_files;
     pack->hash_size = hash_size;
     pack->files = (packfile_t *)(pack + 1);
@@ -2418,6 +2796,8 @@ static void q_printf(2, 3) add_game_dir(unsigned mode, const char *fmt, ...)
     FS_ReplaceSeparators(fs_gamedir, '/');
 #endif
 
+    FS_FlushIndex();
+
     // add the directory to the search path
     search = FS_Malloc(sizeof(searchpath_t) + len);
     search->mode = mode;
@@ -2455,6 +2835,8 @@ static void q_printf(2, 3) add_game_dir(unsigned mode, const char *fmt, ...)
             pack = load_pak_file(path);
         if (!pack)
             continue;
+        if (fs_mmap->integer)
+            pack_map(pack);
         search = FS_Malloc(sizeof(searchpath_t));
         search->mode = mode;
         search->filename[0] = 0;
@@ -3232,6 +3614,7 @@ static void FS_UnLink_f(void)
             return;
         case 'a':
             free_all_links(list);
+            FS_FlushIndex();
             Com_Printf("Deleted all symbolic links.\n");
             return;
         default:
@@ -3251,6 +3634,7 @@ static void FS_UnLink_f(void)
             List_Remove(&link->entry);
             Z_Free(link->target);
             Z_Free(link);
+            FS_FlushIndex();
             return;
         }
     }
@@ -3322,6 +3706,8 @@ static void FS_Link_f(void)
 update:
     link->target = FS_CopyString(target);
     link->targlen = targlen;
+
+    FS_FlushIndex();
 }
 
 static void free_search_path(searchpath_t *path)
@@ -3334,6 +3720,8 @@ static void free_all_paths(void)
 {
     searchpath_t *path, *next;
 
+    FS_FlushIndex();
+
     for (path = fs_searchpaths; path; path = next) {
         next = path->next;
         free_search_path(path);
@@ -3346,6 +3734,8 @@ static void free_game_paths(void)
 {
     searchpath_t *path, *next;
 
+    FS_FlushIndex();
+
     for (path = fs_searchpaths; path != fs_base_searchpaths; path = next) {
         next = path->next;
         free_search_path(path);
@@ -3549,6 +3939,11 @@ static void fs_game_changed(cvar_t *self)
     Com_AddConfigFile(COM_POSTEXEC_CFG, FS_TYPE_REAL);
 }
 
+static void fs_index_changed(cvar_t *self)
+{
+    FS_FlushIndex();
+}
+
 /*
 ================
 FS_Init
@@ -3560,6 +3955,7 @@ void FS_Init(void)
 
     List_Init(&fs_hard_links);
     List_Init(&fs_soft_links);
+    List_Init(&fs_mapped_packs);
 
     Cmd_Register(c_fs);
 
@@ -3567,6 +3963,10 @@ void FS_Init(void)
     fs_debug = Cvar_Get("fs_debug", "0", 0);
 #endif
 
+    fs_mmap = Cvar_Get("fs_mmap", "0", 0);
+    fs_index = Cvar_Get("fs_index", "0", 0);
+    fs_index->changed = fs_index_changed;
+
     // get the game cvar and start the filesystem
     fs_game = Cvar_Get("game", DEFGAME, CVAR_LATCH | CVAR_SERVERINFO);
     fs_game->changed = fs_game_changed;
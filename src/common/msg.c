@@ -31,7 +31,8 @@ Handles byte ordering and avoids alignment errors
 ==============================================================================
 */
 
-sizebuf_t   msg_write;
+// thread local, so that server can encode client frames in parallel
+q_threadlocal sizebuf_t msg_write;
 byte        msg_write_buffer[MAX_MSGLEN];
 
 sizebuf_t   msg_read;
@@ -213,7 +214,7 @@ void MSG_WriteAngle(float f)
     MSG_WriteByte(ANGLE2BYTE(f));
 }
 
-#if USE_CLIENT
+#if USE_CLIENT || USE_LOADGEN
 
 /*
 =============
@@ -452,7 +453,7 @@ int MSG_WriteDeltaUsercmd_Enhanced(const usercmd_t *from,
     return bits;
 }
 
-#endif // USE_CLIENT
+#endif // USE_CLIENT || USE_LOADGEN
 
 void MSG_WriteDir(const vec3_t dir)
 {
@@ -1515,7 +1516,7 @@ size_t MSG_ReadStringLine(char *dest, size_t size)
     return len;
 }
 
-#if USE_CLIENT || USE_MVD_CLIENT
+#if USE_CLIENT || USE_MVD_CLIENT || USE_LOADGEN
 
 static inline float MSG_ReadCoord(void)
 {
@@ -1544,7 +1545,7 @@ static inline float MSG_ReadAngle16(void)
 
 #endif
 
-#if USE_CLIENT
+#if USE_CLIENT || USE_LOADGEN
 void MSG_ReadDir(vec3_t dir)
 {
     int     b;
@@ -1787,7 +1788,7 @@ void MSG_ReadDeltaUsercmd_Enhanced(const usercmd_t *from,
     }
 }
 
-#if USE_CLIENT || USE_MVD_CLIENT
+#if USE_CLIENT || USE_MVD_CLIENT || USE_LOADGEN
 
 /*
 =================
@@ -1946,9 +1947,9 @@ void MSG_ParseDeltaEntity(const entity_state_t *from,
     }
 }
 
-#endif // USE_CLIENT || USE_MVD_CLIENT
+#endif // USE_CLIENT || USE_MVD_CLIENT || USE_LOADGEN
 
-#if USE_CLIENT
+#if USE_CLIENT || USE_LOADGEN
 
 /*
 ===================
@@ -2194,7 +2195,185 @@ void MSG_ParseDeltaPlayerstate_Enhanced(const player_state_t    *from,
 
 }
 
-#endif // USE_CLIENT
+/*
+===================
+MSG_ParseTEntPacket
+
+Returns false if temp entity type is unknown.
+===================
+*/
+bool MSG_ParseTEntPacket(tent_params_t *te)
+{
+    te->type = MSG_ReadByte();
+
+    switch (te->type) {
+    case TE_BLOOD:
+    case TE_GUNSHOT:
+    case TE_SPARKS:
+    case TE_BULLET_SPARKS:
+    case TE_SCREEN_SPARKS:
+    case TE_SHIELD_SPARKS:
+    case TE_SHOTGUN:
+    case TE_BLASTER:
+    case TE_GREENBLOOD:
+    case TE_BLASTER2:
+    case TE_FLECHETTE:
+    case TE_HEATBEAM_SPARKS:
+    case TE_HEATBEAM_STEAM:
+    case TE_MOREBLOOD:
+    case TE_ELECTRIC_SPARKS:
+        MSG_ReadPos(te->pos1);
+        MSG_ReadDir(te->dir);
+        break;
+
+    case TE_SPLASH:
+    case TE_LASER_SPARKS:
+    case TE_WELDING_SPARKS:
+    case TE_TUNNEL_SPARKS:
+        te->count = MSG_ReadByte();
+        MSG_ReadPos(te->pos1);
+        MSG_ReadDir(te->dir);
+        te->color = MSG_ReadByte();
+        break;
+
+    case TE_BLUEHYPERBLASTER:
+    case TE_RAILTRAIL:
+    case TE_BUBBLETRAIL:
+    case TE_DEBUGTRAIL:
+    case TE_BUBBLETRAIL2:
+    case TE_BFG_LASER:
+        MSG_ReadPos(te->pos1);
+        MSG_ReadPos(te->pos2);
+        break;
+
+    case TE_GRENADE_EXPLOSION:
+    case TE_GRENADE_EXPLOSION_WATER:
+    case TE_EXPLOSION2:
+    case TE_PLASMA_EXPLOSION:
+    case TE_ROCKET_EXPLOSION:
+    case TE_ROCKET_EXPLOSION_WATER:
+    case TE_EXPLOSION1:
+    case TE_EXPLOSION1_NP:
+    case TE_EXPLOSION1_BIG:
+    case TE_BFG_EXPLOSION:
+    case TE_BFG_BIGEXPLOSION:
+    case TE_BOSSTPORT:
+    case TE_PLAIN_EXPLOSION:
+    case TE_CHAINFIST_SMOKE:
+    case TE_TRACKER_EXPLOSION:
+    case TE_TELEPORT_EFFECT:
+    case TE_DBALL_GOAL:
+    case TE_WIDOWSPLASH:
+    case TE_NUKEBLAST:
+        MSG_ReadPos(te->pos1);
+        break;
+
+    case TE_PARASITE_ATTACK:
+    case TE_MEDIC_CABLE_ATTACK:
+    case TE_HEATBEAM:
+    case TE_MONSTER_HEATBEAM:
+        te->entity1 = MSG_ReadShort();
+        MSG_ReadPos(te->pos1);
+        MSG_ReadPos(te->pos2);
+        break;
+
+    case TE_GRAPPLE_CABLE:
+        te->entity1 = MSG_ReadShort();
+        MSG_ReadPos(te->pos1);
+        MSG_ReadPos(te->pos2);
+        MSG_ReadPos(te->offset);
+        break;
+
+    case TE_LIGHTNING:
+        te->entity1 = MSG_ReadShort();
+        te->entity2 = MSG_ReadShort();
+        MSG_ReadPos(te->pos1);
+        MSG_ReadPos(te->pos2);
+        break;
+
+    case TE_FLASHLIGHT:
+        MSG_ReadPos(te->pos1);
+        te->entity1 = MSG_ReadShort();
+        break;
+
+    case TE_FORCEWALL:
+        MSG_ReadPos(te->pos1);
+        MSG_ReadPos(te->pos2);
+        te->color = MSG_ReadByte();
+        break;
+
+    case TE_STEAM:
+        te->entity1 = MSG_ReadShort();
+        te->count = MSG_ReadByte();
+        MSG_ReadPos(te->pos1);
+        MSG_ReadDir(te->dir);
+        te->color = MSG_ReadByte();
+        te->entity2 = MSG_ReadShort();
+        if (te->entity1 != -1) {
+            te->time = MSG_ReadLong();
+        }
+        break;
+
+    case TE_WIDOWBEAMOUT:
+        te->entity1 = MSG_ReadShort();
+        MSG_ReadPos(te->pos1);
+        break;
+
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+/*
+===================
+MSG_ParseStartSoundPacket
+
+Entity and sound index are not range checked.
+===================
+*/
+void MSG_ParseStartSoundPacket(snd_params_t *snd)
+{
+    int flags, channel;
+
+    flags = MSG_ReadByte();
+
+    snd->index = MSG_ReadByte();
+
+    if (flags & SND_VOLUME)
+        snd->volume = MSG_ReadByte() / 255.0f;
+    else
+        snd->volume = DEFAULT_SOUND_PACKET_VOLUME;
+
+    if (flags & SND_ATTENUATION)
+        snd->attenuation = MSG_ReadByte() / 64.0f;
+    else
+        snd->attenuation = DEFAULT_SOUND_PACKET_ATTENUATION;
+
+    if (flags & SND_OFFSET)
+        snd->timeofs = MSG_ReadByte() / 1000.0f;
+    else
+        snd->timeofs = 0;
+
+    if (flags & SND_ENT) {
+        // entity relative
+        channel = MSG_ReadShort();
+        snd->entity = channel >> 3;
+        snd->channel = channel & 7;
+    } else {
+        snd->entity = 0;
+        snd->channel = 0;
+    }
+
+    // positioned in space
+    if (flags & SND_POS)
+        MSG_ReadPos(snd->pos);
+
+    snd->flags = flags;
+}
+
+#endif // USE_CLIENT || USE_LOADGEN
 
 #if USE_MVD_CLIENT
 
@@ -95,6 +95,9 @@ static cvar_t       *showdrop;
 #define SHOWDROP(...)
 #endif
 
+// sequences, qport and fragment offset
+#define NETCHAN_HEADER_MAX  16
+
 cvar_t      *net_qport;
 cvar_t      *net_maxmsglen;
 cvar_t      *net_chantype;
@@ -165,6 +168,20 @@ void Netchan_OutOfBand(netsrc_t sock, const netadr_t *address,
 
 // ============================================================================
 
+// sends datagram through private socket of load generator client, if any
+static void Netchan_SendPacketv(netchan_t *netchan, const netvec_t *vec, int count)
+{
+#if USE_LOADGEN
+    if (netchan->privsock != -1) {
+        NET_SendPrivatev(netchan->privsock, vec, count, &netchan->remote_address);
+        return;
+    }
+#endif
+    NET_SendPacketv(netchan->sock, vec, count, &netchan->remote_address);
+}
+
+// ============================================================================
+
 static size_t NetchanOld_TransmitNextFragment(netchan_t *netchan)
 {
     Com_Error(ERR_FATAL, "%s: not implemented", __func__);
@@ -185,10 +202,12 @@ static size_t NetchanOld_Transmit(netchan_t *netchan, size_t length, const void
 {
     netchan_old_t *chan = (netchan_old_t *)netchan;
     sizebuf_t   send;
-    byte        send_buf[MAX_PACKETLEN];
+    byte        send_buf[NETCHAN_HEADER_MAX];
+    netvec_t    vec[3];
+    size_t      total;
     bool        send_reliable;
     uint32_t    w1, w2;
-    int         i;
+    int         i, count;
 
 // check for message overflow
     if (netchan->message.overflowed) {
@@ -227,7 +246,7 @@ static size_t NetchanOld_Transmit(netchan_t *netchan, size_t length, const void
     SZ_WriteLong(&send, w1);
     SZ_WriteLong(&send, w2);
 
-#if USE_CLIENT
+#if USE_CLIENT || USE_LOADGEN
     // send the qport if we are a client
     if (netchan->sock == NS_CLIENT) {
         if (netchan->protocol < PROTOCOL_VERSION_R1Q2) {
@@ -238,21 +257,35 @@ static size_t NetchanOld_Transmit(netchan_t *netchan, size_t length, const void
     }
 #endif
 
-// copy the reliable message to the packet first
+    vec[0].data = send.data;
+    vec[0].len = send.cursize;
+    total = send.cursize;
+    count = 1;
+
+// reference the reliable message first
     if (send_reliable) {
-        SZ_Write(&send, chan->reliable_buf, netchan->reliable_length);
+        vec[count].data = chan->reliable_buf;
+        vec[count].len = netchan->reliable_length;
+        total += netchan->reliable_length;
+        count++;
         chan->last_reliable_sequence = netchan->outgoing_sequence;
     }
 
 // add the unreliable part if space is available
-    if (send.maxsize - send.cursize >= length)
-        SZ_Write(&send, data, length);
-    else
+    if (MAX_PACKETLEN - total >= length) {
+        if (length) {
+            vec[count].data = data;
+            vec[count].len = length;
+            total += length;
+            count++;
+        }
+    } else {
         Com_WPrintf("%s: dumped unreliable\n",
                     NET_AdrToString(&netchan->remote_address));
+    }
 
     SHOWPACKET("send %4zu : s=%d ack=%d rack=%d",
-               send.cursize,
+               total,
                netchan->outgoing_sequence,
                netchan->incoming_sequence,
                chan->incoming_reliable_sequence);
@@ -263,15 +296,14 @@ static size_t NetchanOld_Transmit(netchan_t *netchan, size_t length, const void
 
     // send the datagram
     for (i = 0; i < numpackets; i++) {
-        NET_SendPacket(netchan->sock, send.data, send.cursize,
-                       &netchan->remote_address);
+        Netchan_SendPacketv(netchan, vec, count);
     }
 
     netchan->outgoing_sequence++;
     netchan->reliable_ack_pending = false;
     netchan->last_sent = com_localTime;
 
-    return send.cursize * numpackets;
+    return total * numpackets;
 }
 
 /*
@@ -294,7 +326,7 @@ static bool NetchanOld_Process(netchan_t *netchan)
     sequence_ack = MSG_ReadLong();
 
     // read the qport if we are a server
-#if USE_CLIENT
+#if USE_CLIENT || USE_LOADGEN
     if (netchan->sock == NS_SERVER)
 #endif
     {
@@ -438,7 +470,8 @@ static size_t NetchanNew_TransmitNextFragment(netchan_t *netchan)
 {
     netchan_new_t *chan = (netchan_new_t *)netchan;
     sizebuf_t   send;
-    byte        send_buf[MAX_PACKETLEN];
+    byte        send_buf[NETCHAN_HEADER_MAX];
+    netvec_t    vec[2];
     bool        send_reliable;
     uint32_t    w1, w2;
     uint16_t    offset;
@@ -458,7 +491,7 @@ static size_t NetchanNew_TransmitNextFragment(netchan_t *netchan)
     SZ_WriteLong(&send, w1);
     SZ_WriteLong(&send, w2);
 
-#if USE_CLIENT
+#if USE_CLIENT || USE_LOADGEN
     // send the qport if we are a client
     if (netchan->sock == NS_CLIENT && netchan->qport) {
         SZ_WriteByte(&send, netchan->qport);
@@ -481,13 +514,15 @@ static size_t NetchanNew_TransmitNextFragment(netchan_t *netchan)
              (more_fragments << 15);
     SZ_WriteShort(&send, offset);
 
-    // write fragment contents
-    SZ_Write(&send, chan->fragment_out.data + chan->fragment_out.readcount,
-             fragment_length);
+    // reference fragment contents
+    vec[0].data = send.data;
+    vec[0].len = send.cursize;
+    vec[1].data = chan->fragment_out.data + chan->fragment_out.readcount;
+    vec[1].len = fragment_length;
 
     SHOWPACKET("send %4zu : s=%d ack=%d rack=%d "
                "fragment_offset=%zu more_fragments=%d",
-               send.cursize,
+               send.cursize + fragment_length,
                netchan->outgoing_sequence,
                netchan->incoming_sequence,
                chan->incoming_reliable_sequence,
@@ -501,6 +536,9 @@ static size_t NetchanNew_TransmitNextFragment(netchan_t *netchan)
     chan->fragment_out.readcount += fragment_length;
     netchan->fragment_pending = more_fragments;
 
+    // send the datagram before fragment buffer may be cleared
+    Netchan_SendPacketv(netchan, vec, 2);
+
     // if the message has been sent completely, clear the fragment buffer
     if (!netchan->fragment_pending) {
         netchan->outgoing_sequence++;
@@ -508,11 +546,7 @@ static size_t NetchanNew_TransmitNextFragment(netchan_t *netchan)
         SZ_Clear(&chan->fragment_out);
     }
 
-    // send the datagram
-    NET_SendPacket(netchan->sock, send.data, send.cursize,
-                   &netchan->remote_address);
-
-    return send.cursize;
+    return vec[0].len + vec[1].len;
 }
 
 /*
@@ -524,10 +558,12 @@ static size_t NetchanNew_Transmit(netchan_t *netchan, size_t length, const void
 {
     netchan_new_t *chan = (netchan_new_t *)netchan;
     sizebuf_t   send;
-    byte        send_buf[MAX_PACKETLEN];
+    byte        send_buf[NETCHAN_HEADER_MAX];
+    netvec_t    vec[3];
+    size_t      total;
     bool        send_reliable;
     uint32_t    w1, w2;
-    int         i;
+    int         i, count;
 
 // check for message overflow
     if (netchan->message.overflowed) {
@@ -585,24 +621,37 @@ static size_t NetchanNew_Transmit(netchan_t *netchan, size_t length, const void
     SZ_WriteLong(&send, w1);
     SZ_WriteLong(&send, w2);
 
-#if USE_CLIENT
+#if USE_CLIENT || USE_LOADGEN
     // send the qport if we are a client
     if (netchan->sock == NS_CLIENT && netchan->qport) {
         SZ_WriteByte(&send, netchan->qport);
     }
 #endif
 
-    // copy the reliable message to the packet first
+    vec[0].data = send.data;
+    vec[0].len = send.cursize;
+    total = send.cursize;
+    count = 1;
+
+    // reference the reliable message first
     if (send_reliable) {
         chan->last_reliable_sequence = netchan->outgoing_sequence;
-        SZ_Write(&send, chan->reliable_buf, netchan->reliable_length);
+        vec[count].data = chan->reliable_buf;
+        vec[count].len = netchan->reliable_length;
+        total += netchan->reliable_length;
+        count++;
     }
 
     // add the unreliable part
-    SZ_Write(&send, data, length);
+    if (length) {
+        vec[count].data = data;
+        vec[count].len = length;
+        total += length;
+        count++;
+    }
 
     SHOWPACKET("send %4zu : s=%d ack=%d rack=%d",
-               send.cursize,
+               total,
                netchan->outgoing_sequence,
                netchan->incoming_sequence,
                chan->incoming_reliable_sequence);
@@ -613,15 +662,14 @@ static size_t NetchanNew_Transmit(netchan_t *netchan, size_t length, const void
 
     // send the datagram
     for (i = 0; i < numpackets; i++) {
-        NET_SendPacket(netchan->sock, send.data, send.cursize,
-                       &netchan->remote_address);
+        Netchan_SendPacketv(netchan, vec, count);
     }
 
     netchan->outgoing_sequence++;
     netchan->reliable_ack_pending = false;
     netchan->last_sent = com_localTime;
 
-    return send.cursize * numpackets;
+    return total * numpackets;
 }
 
 /*
@@ -643,7 +691,7 @@ static bool NetchanNew_Process(netchan_t *netchan)
     sequence_ack = MSG_ReadLong();
 
     // read the qport if we are a server
-#if USE_CLIENT
+#if USE_CLIENT || USE_LOADGEN
     if (netchan->sock == NS_SERVER)
 #endif
         if (netchan->qport) {
@@ -853,6 +901,9 @@ netchan_t *Netchan_Setup(netsrc_t sock, netchan_type_t type,
 
     netchan->protocol = protocol;
     netchan->type = type;
+#if USE_LOADGEN
+    netchan->privsock = -1;
+#endif
 
     return netchan;
 
@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 // net.c
 //
 
+#define _GNU_SOURCE
 #include "shared/shared.h"
 #include "common/common.h"
 #include "common/cvar.h"
@@ -31,6 +32,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/net/net.h"
 #include "common/protocol.h"
 #include "common/zone.h"
+#include "shared/list.h"
 #include "client/client.h"
 #include "server/server.h"
 #include "system/system.h"
@@ -51,6 +53,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <arpa/inet.h>
 #include <errno.h>
 #ifdef __linux__
+#include <sys/epoll.h>
 #include <linux/types.h>
 #if USE_ICMP
 #include <linux/errqueue.h>
@@ -64,6 +67,45 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 // prevents infinite retry loops caused by broken TCP/IP stacks
 #define MAX_ERROR_RETRIES   64
 
+// edge-triggered readiness notification with epoll
+#ifdef __linux__
+#define USE_EPOLL   1
+#else
+#define USE_EPOLL   0
+#endif
+
+// epoll is not limited by FD_SETSIZE
+#if USE_EPOLL
+#define MAX_IO_ENTRIES  65536
+#else
+#define MAX_IO_ENTRIES  FD_SETSIZE
+#endif
+
+// batched datagram I/O with recvmmsg/sendmmsg
+#if (defined __linux__) && (defined MSG_WAITFORONE)
+#define USE_MMSG    1
+#else
+#define USE_MMSG    0
+#endif
+
+#if USE_MMSG
+
+#define NET_BATCH_MAX   32
+
+typedef struct {
+    byte        data[MAX_PACKETLEN];
+    size_t      len;
+    netadr_t    adr;
+    qsocket_t   sock;
+} netbatch_t;
+
+static netbatch_t   net_recvbatch[NET_BATCH_MAX];
+static netbatch_t   net_sendbatch[NET_BATCH_MAX];
+static int          net_sendcount;
+static bool         net_batching[NS_COUNT];
+
+#endif // USE_MMSG
+
 #if USE_CLIENT
 
 #define MAX_LOOPBACK    4
@@ -106,6 +148,19 @@ static cvar_t   *net_enable_ipv6;
 static cvar_t   *net_ignore_icmp;
 #endif
 
+#if USE_MMSG
+static cvar_t   *net_batch;
+#endif
+
+static cvar_t   *net_sim;
+static cvar_t   *net_sim_latency;
+static cvar_t   *net_sim_jitter;
+static cvar_t   *net_sim_loss;
+static cvar_t   *net_sim_burst;
+static cvar_t   *net_sim_dup;
+static cvar_t   *net_sim_reorder;
+static cvar_t   *net_sim_seed;
+
 static netflag_t    net_active;
 static int          net_error;
 
@@ -119,7 +174,7 @@ static qsocket_t    tcp6_socket = -1;
 static qhandle_t    net_logFile;
 #endif
 
-static ioentry_t    io_entries[FD_SETSIZE];
+static ioentry_t    io_entries[MAX_IO_ENTRIES];
 static int          io_numfds;
 
 // current rate measurement
@@ -140,6 +195,33 @@ static uint64_t     net_bytes_sent;
 static uint64_t     net_packets_rcvd;
 static uint64_t     net_packets_sent;
 
+// network impairment
+#define NETSIM_OUT          1
+#define NETSIM_IN           2
+#define NETSIM_MAX_QUEUE    1024
+
+typedef struct {
+    list_t      entry;
+    unsigned    time;       // when to deliver
+    netsrc_t    sock;
+    netadr_t    adr;
+    size_t      len;
+    byte        data[1];
+} simpacket_t;
+
+typedef struct {
+    list_t      queue;      // sorted by delivery time
+    int         count;
+    uint32_t    rand;       // PRNG state
+    bool        lossy;      // in the middle of loss burst
+} simdir_t;
+
+static simdir_t     net_simdirs[2];
+static netsrc_t     net_simsrc;
+static uint64_t     net_sim_lost;
+static uint64_t     net_sim_duped;
+static uint64_t     net_sim_reordered;
+
 //=============================================================================
 
 static size_t NET_NetadrToSockadr(const netadr_t *a, struct sockaddr_storage *s)
@@ -521,6 +603,9 @@ static void NET_Stats_f(void)
     Com_Printf("Total errors: %"PRIu64"/%"PRIu64" (send/recv)\n",
                net_send_errors, net_recv_errors);
 #endif
+    if (net_sim_lost || net_sim_duped || net_sim_reordered)
+        Com_Printf("Impaired packets: %"PRIu64"/%"PRIu64"/%"PRIu64" (lost/duped/reordered)\n",
+                   net_sim_lost, net_sim_duped, net_sim_reordered);
     Com_Printf("Current upload rate: %zu bytes/sec\n", net_rate_up);
     Com_Printf("Current download rate: %zu bytes/sec\n", net_rate_dn);
 }
@@ -537,6 +622,20 @@ static size_t NET_DnRate_m(char *buffer, size_t size)
 
 //=============================================================================
 
+// copies pieces of datagram into contiguous buffer
+static size_t NET_GatherPacket(byte *buf, const netvec_t *vec, int count)
+{
+    size_t len = 0;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        memcpy(buf + len, vec[i].data, vec[i].len);
+        len += vec[i].len;
+    }
+
+    return len;
+}
+
 #if USE_CLIENT
 
 static void NET_GetLoopPackets(netsrc_t sock, void (*packet_cb)(void))
@@ -572,8 +671,8 @@ static void NET_GetLoopPackets(netsrc_t sock, void (*packet_cb)(void))
     }
 }
 
-static bool NET_SendLoopPacket(netsrc_t sock, const void *data,
-                               size_t len, const netadr_t *to)
+static bool NET_SendLoopPacket(netsrc_t sock, const netvec_t *vec,
+                               int count, const netadr_t *to)
 {
     loopback_t *loop;
     loopmsg_t *msg;
@@ -587,16 +686,15 @@ static bool NET_SendLoopPacket(netsrc_t sock, const void *data,
     msg = &loop->msgs[loop->send & (MAX_LOOPBACK - 1)];
     loop->send++;
 
-    memcpy(msg->data, data, len);
-    msg->datalen = len;
+    msg->datalen = NET_GatherPacket(msg->data, vec, count);
 
 #ifdef _DEBUG
     if (net_log_enable->integer > 1) {
-        NET_LogPacket(to, "LP send", data, len);
+        NET_LogPacket(to, "LP send", msg->data, msg->datalen);
     }
 #endif
     if (sock == NS_CLIENT) {
-        net_rate_sent += len;
+        net_rate_sent += msg->datalen;
     }
 
     return true;
@@ -642,6 +740,214 @@ static void NET_ErrorEvent(qsocket_t sock, netadr_t *from,
 
 //=============================================================================
 
+/*
+===============================================================================
+
+NETWORK IMPAIRMENT
+
+Packets going out through NET_SendPacket and/or coming in through
+NET_GetPackets can be delayed, dropped, duplicated and reordered to test
+netcode under WAN conditions. Random decisions come from a private PRNG
+with a fixed seed, so the same traffic pattern is impaired the same way
+on every run.
+
+===============================================================================
+*/
+
+static bool NET_TransmitPacket(netsrc_t sock, const netvec_t *vec,
+                               int count, size_t len, const netadr_t *to);
+
+static void net_sim_changed(cvar_t *self)
+{
+    simdir_t *dir;
+    int i;
+
+    for (i = 0, dir = net_simdirs; i < 2; i++, dir++) {
+        dir->rand = (uint32_t)net_sim_seed->integer * 0x9E3779B9 + (i + 1) * 0x85EBCA6B;
+        if (!dir->rand)
+            dir->rand = 1;
+        dir->lossy = false;
+    }
+}
+
+// xorshift32, returns [0, 1)
+static float NET_SimRand(simdir_t *dir)
+{
+    uint32_t x = dir->rand;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    dir->rand = x;
+
+    return (x >> 8) * (1.0f / (1 << 24));
+}
+
+// Gilbert model: mean loss rate is net_sim_loss, and losses come in
+// bursts of net_sim_burst packets on average
+static bool NET_SimLoss(simdir_t *dir)
+{
+    float loss = Cvar_ClampValue(net_sim_loss, 0, 100) * 0.01f;
+    float burst = net_sim_burst->value;
+    float recover;
+
+    if (loss <= 0)
+        return false;
+
+    if (burst <= 1 || loss >= 1)
+        return NET_SimRand(dir) < loss;
+
+    recover = 1 / burst;
+    if (dir->lossy) {
+        if (NET_SimRand(dir) < recover)
+            dir->lossy = false;
+    } else {
+        if (NET_SimRand(dir) < loss * recover / (1 - loss))
+            dir->lossy = true;
+    }
+
+    return dir->lossy;
+}
+
+static void NET_SimQueue(int dirnum, netsrc_t sock, const netvec_t *vec,
+                         int count, size_t len, const netadr_t *adr)
+{
+    simdir_t *dir = &net_simdirs[dirnum - 1];
+    unsigned delay, now = Sys_Milliseconds();
+    simpacket_t *p;
+    list_t *cursor;
+    int i, copies;
+
+    if (NET_SimLoss(dir)) {
+        net_sim_lost++;
+        return;
+    }
+
+    copies = 1;
+    if (NET_SimRand(dir) * 100 < net_sim_dup->value) {
+        net_sim_duped++;
+        copies++;
+    }
+
+    for (i = 0; i < copies; i++) {
+        // queue overflow drops packets just like a router would
+        if (dir->count >= NETSIM_MAX_QUEUE) {
+            net_sim_lost++;
+            return;
+        }
+
+        delay = Cvar_ClampInteger(net_sim_latency, 0, 10000);
+        delay += NET_SimRand(dir) * Cvar_ClampInteger(net_sim_jitter, 0, 10000);
+
+        // like netem, reordered packets skip the delay and
+        // overtake packets that are already queued
+        if (delay && NET_SimRand(dir) * 100 < net_sim_reorder->value) {
+            net_sim_reordered++;
+            delay = 0;
+        }
+
+        p = Z_Malloc(sizeof(*p) + len - 1);
+        p->time = now + delay;
+        p->sock = sock;
+        p->adr = *adr;
+        p->len = len;
+        NET_GatherPacket(p->data, vec, count);
+
+        // insert after the last packet that is due not later than this one
+        for (cursor = dir->queue.prev; cursor != &dir->queue; cursor = cursor->prev) {
+            if ((int)(LIST_ENTRY(simpacket_t, cursor, entry)->time - p->time) <= 0)
+                break;
+        }
+        List_Insert(cursor, &p->entry);
+        dir->count++;
+    }
+}
+
+// packet_cb replacement for incoming packets
+static void NET_SimReceived(void)
+{
+    netvec_t vec = { msg_read.data, msg_read.cursize };
+
+    NET_SimQueue(NETSIM_IN, net_simsrc, &vec, 1, vec.len, &net_from);
+}
+
+static void NET_SimDeliver(netsrc_t sock, void (*packet_cb)(void))
+{
+    simdir_t *dir;
+    simpacket_t *p, *next;
+    unsigned now = Sys_Milliseconds();
+    netvec_t vec;
+
+    dir = &net_simdirs[NETSIM_OUT - 1];
+    LIST_FOR_EACH_SAFE(simpacket_t, p, next, &dir->queue, entry) {
+        if ((int)(p->time - now) > 0)
+            break;
+        if (p->sock != sock)
+            continue;
+        vec.data = p->data;
+        vec.len = p->len;
+        NET_TransmitPacket(sock, &vec, 1, p->len, &p->adr);
+        List_Remove(&p->entry);
+        dir->count--;
+        Z_Free(p);
+    }
+
+    dir = &net_simdirs[NETSIM_IN - 1];
+    LIST_FOR_EACH_SAFE(simpacket_t, p, next, &dir->queue, entry) {
+        if ((int)(p->time - now) > 0)
+            break;
+        if (p->sock != sock)
+            continue;
+
+        // packet handler may throw an error, so free packet first
+        memcpy(msg_read_buffer, p->data, p->len);
+        SZ_Init(&msg_read, msg_read_buffer, sizeof(msg_read_buffer));
+        msg_read.cursize = p->len;
+        net_from = p->adr;
+        List_Remove(&p->entry);
+        dir->count--;
+        Z_Free(p);
+
+        (*packet_cb)();
+
+        // queue might have been modified, so restart
+        next = LIST_FIRST(simpacket_t, &dir->queue, entry);
+    }
+}
+
+// don't oversleep delivery of the earliest queued packet
+static int NET_SimSleep(int msec)
+{
+    unsigned now = Sys_Milliseconds();
+    simpacket_t *p;
+    int i, delta;
+
+    for (i = 0; i < 2; i++) {
+        if (LIST_EMPTY(&net_simdirs[i].queue))
+            continue;
+        p = LIST_FIRST(simpacket_t, &net_simdirs[i].queue, entry);
+        delta = p->time - now;
+        msec = min(msec, max(delta, 0));
+    }
+
+    return msec;
+}
+
+static void NET_SimClear(void)
+{
+    simpacket_t *p, *next;
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        LIST_FOR_EACH_SAFE(simpacket_t, p, next, &net_simdirs[i].queue, entry)
+            Z_Free(p);
+        List_Init(&net_simdirs[i].queue);
+        net_simdirs[i].count = 0;
+    }
+}
+
+//=============================================================================
+
 // include our wrappers to hide platfrom-specific details
 #ifdef _WIN32
 #include "win.h"
@@ -686,6 +992,10 @@ void NET_RemoveFd(qsocket_t fd)
     ioentry_t *e = os_get_io(fd);
     int i;
 
+#if USE_EPOLL
+    os_remove_io(fd);
+#endif
+
     memset(e, 0, sizeof(*e));
 
     for (i = io_numfds - 1; i >= 0; i--) {
@@ -698,6 +1008,50 @@ void NET_RemoveFd(qsocket_t fd)
     io_numfds = i + 1;
 }
 
+#if USE_EPOLL
+
+/*
+=============
+NET_Sleep
+
+Sleeps msec or until some file descriptor is ready. Descriptors are
+registered with epoll in edge-triggered mode, so readiness flags are not
+reset here. They stay set until the consumer clears them after getting
+EWOULDBLOCK, and sleep is skipped while any wanted descriptor has them set.
+=============
+*/
+int NET_Sleep(int msec)
+{
+    msec = NET_SimSleep(msec);
+
+    if (!io_numfds) {
+        // don't bother with epoll_wait()
+        Sys_Sleep(msec);
+        return 0;
+    }
+
+    return os_poll(msec);
+}
+
+#if USE_AC_SERVER
+
+/*
+=============
+NET_Sleepv
+
+With epoll there is no benefit in waiting on a subset of descriptors:
+readiness of other descriptors is not lost, but recorded for later.
+=============
+*/
+int NET_Sleepv(int msec, ...)
+{
+    return NET_Sleep(msec);
+}
+
+#endif // USE_AC_SERVER
+
+#else // USE_EPOLL
+
 /*
 =============
 NET_Sleep
@@ -715,6 +1069,8 @@ int NET_Sleep(int msec)
     qsocket_t fd;
     int i, ret;
 
+    msec = NET_SimSleep(msec);
+
     if (!io_numfds) {
         // don't bother with select()
         Sys_Sleep(msec);
@@ -838,8 +1194,65 @@ int NET_Sleepv(int msec, ...)
 
 #endif // USE_AC_SERVER
 
+#endif // !USE_EPOLL
+
 //=============================================================================
 
+static void NET_ReceivedPacket(const void *data, size_t len)
+{
+#ifdef _DEBUG
+    if (net_log_enable->integer)
+        NET_LogPacket(&net_from, "UDP recv", data, len);
+#endif
+
+    net_rate_rcvd += len;
+    net_bytes_rcvd += len;
+    net_packets_rcvd++;
+
+    SZ_Init(&msg_read, msg_read_buffer, sizeof(msg_read_buffer));
+    msg_read.cursize = len;
+}
+
+#if USE_MMSG
+
+// drains the socket with recvmmsg. returns false if the caller should
+// fall back to regular path to receive and report the pending error.
+static bool NET_GetUdpPacketsBatch(qsocket_t sock, void (*packet_cb)(void))
+{
+    ioentry_t *e = os_get_io(sock);
+    netbatch_t *b;
+    int i, ret;
+
+    while (1) {
+        ret = os_udp_recv_many(sock, net_recvbatch, NET_BATCH_MAX);
+        if (ret == NET_AGAIN) {
+            e->canread = false;
+            return true;
+        }
+
+        if (ret == NET_ERROR) {
+            return false;
+        }
+
+        for (i = 0; i < ret; i++) {
+            b = &net_recvbatch[i];
+            net_from = b->adr;
+            memcpy(msg_read_buffer, b->data, b->len);
+            NET_ReceivedPacket(msg_read_buffer, b->len);
+
+            (*packet_cb)();
+        }
+
+        // short read means the socket is drained
+        if (ret < NET_BATCH_MAX) {
+            e->canread = false;
+            return true;
+        }
+    }
+}
+
+#endif // USE_MMSG
+
 static void NET_GetUdpPackets(qsocket_t sock, void (*packet_cb)(void))
 {
     ioentry_t *e;
@@ -852,6 +1265,11 @@ static void NET_GetUdpPackets(qsocket_t sock, void (*packet_cb)(void))
     if (!e->canread)
         return;
 
+#if USE_MMSG
+    if (net_batch->integer && NET_GetUdpPacketsBatch(sock, packet_cb))
+        return;
+#endif
+
     while (1) {
         ret = os_udp_recv(sock, msg_read_buffer, MAX_PACKETLEN, &net_from);
         if (ret == NET_AGAIN) {
@@ -866,17 +1284,7 @@ static void NET_GetUdpPackets(qsocket_t sock, void (*packet_cb)(void))
             break;
         }
 
-#ifdef _DEBUG
-        if (net_log_enable->integer)
-            NET_LogPacket(&net_from, "UDP recv", msg_read_buffer, ret);
-#endif
-
-        net_rate_rcvd += ret;
-        net_bytes_rcvd += ret;
-        net_packets_rcvd++;
-
-        SZ_Init(&msg_read, msg_read_buffer, sizeof(msg_read_buffer));
-        msg_read.cursize = ret;
+        NET_ReceivedPacket(msg_read_buffer, ret);
 
         (*packet_cb)();
     }
@@ -892,48 +1300,158 @@ net_from variable receives source address.
 */
 void NET_GetPackets(netsrc_t sock, void (*packet_cb)(void))
 {
+    void (*recv_cb)(void) = packet_cb;
+
+    // hold incoming packets in impairment queue
+    if (net_sim->integer & NETSIM_IN) {
+        net_simsrc = sock;
+        recv_cb = NET_SimReceived;
+    }
+
 #if USE_CLIENT
     memset(&net_from, 0, sizeof(net_from));
     net_from.type = NA_LOOPBACK;
 
     // process loopback packets
-    NET_GetLoopPackets(sock, packet_cb);
+    NET_GetLoopPackets(sock, recv_cb);
 #endif
 
     // process UDP packets
-    NET_GetUdpPackets(udp_sockets[sock], packet_cb);
+    NET_GetUdpPackets(udp_sockets[sock], recv_cb);
 
     // process UDP6 packets
-    NET_GetUdpPackets(udp6_sockets[sock], packet_cb);
+    NET_GetUdpPackets(udp6_sockets[sock], recv_cb);
+
+    // send and receive impaired packets that are due
+    NET_SimDeliver(sock, packet_cb);
 }
 
-/*
-=============
-NET_SendPacket
+static void NET_SentPacket(const netvec_t *vec, int count, size_t len,
+                           int ret, const netadr_t *to)
+{
+    if (ret < len)
+        Com_WPrintf("%s: short send to %s\n", __func__,
+                    NET_AdrToString(to));
 
-=============
-*/
-bool NET_SendPacket(netsrc_t sock, const void *data,
-                    size_t len, const netadr_t *to)
+#ifdef _DEBUG
+    if (net_log_enable->integer) {
+        byte buf[MAX_PACKETLEN];
+
+        NET_GatherPacket(buf, vec, count);
+        NET_LogPacket(to, "UDP send", buf, ret);
+    }
+#endif
+
+    net_rate_sent += ret;
+    net_bytes_sent += ret;
+    net_packets_sent++;
+}
+
+static bool NET_SendUdpPacket(qsocket_t s, const netvec_t *vec, int count,
+                              size_t len, const netadr_t *to)
 {
     int ret;
-    qsocket_t s;
 
-    if (len == 0)
+    ret = os_udp_sendv(s, vec, count, to);
+    if (ret == NET_AGAIN)
         return false;
 
-    if (len > MAX_PACKETLEN) {
-        Com_EPrintf("%s: oversize packet to %s\n", __func__,
-                    NET_AdrToString(to));
+    if (ret == NET_ERROR) {
+        Com_DPrintf("%s: %s to %s\n", __func__,
+                    NET_ErrorString(), NET_AdrToString(to));
+        net_send_errors++;
         return false;
     }
 
+    NET_SentPacket(vec, count, len, ret, to);
+    return true;
+}
+
+#if USE_MMSG
+
+static void NET_FlushSendBatch(void)
+{
+    netbatch_t *b;
+    netvec_t vec;
+    int i, j, k, ret;
+
+    for (i = 0; i < net_sendcount; i = j) {
+        // find a run of packets going through the same socket
+        for (j = i + 1; j < net_sendcount; j++)
+            if (net_sendbatch[j].sock != net_sendbatch[i].sock)
+                break;
+
+        while (i < j) {
+            b = &net_sendbatch[i];
+            ret = os_udp_send_many(b->sock, b, j - i);
+            if (ret == NET_AGAIN)
+                break;  // socket buffer is full, drop the rest
+
+            if (ret == NET_ERROR) {
+                // let regular path process error queue and report
+                vec.data = b->data;
+                vec.len = b->len;
+                NET_SendUdpPacket(b->sock, &vec, 1, b->len, &b->adr);
+                i++;
+                continue;
+            }
+
+            for (k = 0; k < ret; k++, b++) {
+                vec.data = b->data;
+                vec.len = b->len;
+                NET_SentPacket(&vec, 1, b->len, b->len, &b->adr);
+            }
+            i += ret;
+        }
+    }
+
+    net_sendcount = 0;
+}
+
+#endif // USE_MMSG
+
+/*
+=============
+NET_BeginBatch
+
+Starts queueing UDP packets sent from this source. Queued packets
+are sent with as few syscalls as possible by NET_FlushBatch.
+=============
+*/
+void NET_BeginBatch(netsrc_t sock)
+{
+#if USE_MMSG
+    if (net_batch->integer)
+        net_batching[sock] = true;
+#endif
+}
+
+/*
+=============
+NET_FlushBatch
+
+Sends out all queued packets and stops queueing.
+=============
+*/
+void NET_FlushBatch(netsrc_t sock)
+{
+#if USE_MMSG
+    net_batching[sock] = false;
+    NET_FlushSendBatch();
+#endif
+}
+
+static bool NET_TransmitPacket(netsrc_t sock, const netvec_t *vec,
+                               int count, size_t len, const netadr_t *to)
+{
+    qsocket_t s;
+
     switch (to->type) {
     case NA_UNSPECIFIED:
         return false;
 #if USE_CLIENT
     case NA_LOOPBACK:
-        return NET_SendLoopPacket(sock, data, len, to);
+        return NET_SendLoopPacket(sock, vec, count, to);
 #endif
     case NA_IP:
     case NA_BROADCAST:
@@ -949,31 +1467,78 @@ bool NET_SendPacket(netsrc_t sock, const void *data,
     if (s == -1)
         return false;
 
-    ret = os_udp_send(s, data, len, to);
-    if (ret == NET_AGAIN)
+#if USE_MMSG
+    if (net_batching[sock]) {
+        netbatch_t *b;
+
+        if (net_sendcount == NET_BATCH_MAX)
+            NET_FlushSendBatch();
+
+        // gather directly into the batch, this is the only copy made
+        b = &net_sendbatch[net_sendcount++];
+        b->len = NET_GatherPacket(b->data, vec, count);
+        b->adr = *to;
+        b->sock = s;
+        return true;
+    }
+#endif
+
+    return NET_SendUdpPacket(s, vec, count, len, to);
+}
+
+/*
+=============
+NET_SendPacketv
+
+Sends datagram made of up to NET_MAX_VECS pieces without assembling it
+in a staging buffer first. Pieces are handed to the kernel with a single
+scatter-gather system call, or gathered directly into the send batch.
+=============
+*/
+bool NET_SendPacketv(netsrc_t sock, const netvec_t *vec,
+                     int count, const netadr_t *to)
+{
+    size_t len = 0;
+    int i;
+
+    if (count < 1 || count > NET_MAX_VECS)
+        Com_Error(ERR_FATAL, "%s: bad count", __func__);
+
+    for (i = 0; i < count; i++)
+        len += vec[i].len;
+
+    if (len == 0)
         return false;
 
-    if (ret == NET_ERROR) {
-        Com_DPrintf("%s: %s to %s\n", __func__,
-                    NET_ErrorString(), NET_AdrToString(to));
-        net_send_errors++;
+    if (len > MAX_PACKETLEN) {
+        Com_EPrintf("%s: oversize packet to %s\n", __func__,
+                    NET_AdrToString(to));
         return false;
     }
 
-    if (ret < len)
-        Com_WPrintf("%s: short send to %s\n", __func__,
-                    NET_AdrToString(to));
+    if (to->type == NA_UNSPECIFIED)
+        return false;
 
-#ifdef _DEBUG
-    if (net_log_enable->integer)
-        NET_LogPacket(to, "UDP send", data, ret);
-#endif
+    if (net_sim->integer & NETSIM_OUT) {
+        NET_SimQueue(NETSIM_OUT, sock, vec, count, len, to);
+        return true;
+    }
 
-    net_rate_sent += ret;
-    net_bytes_sent += ret;
-    net_packets_sent++;
+    return NET_TransmitPacket(sock, vec, count, len, to);
+}
 
-    return true;
+/*
+=============
+NET_SendPacket
+
+=============
+*/
+bool NET_SendPacket(netsrc_t sock, const void *data,
+                    size_t len, const netadr_t *to)
+{
+    netvec_t vec = { data, len };
+
+    return NET_SendPacketv(sock, &vec, 1, to);
 }
 
 //=============================================================================
@@ -1302,6 +1867,77 @@ static void NET_OpenClient6(void)
 }
 #endif
 
+#if USE_LOADGEN
+
+/*
+====================
+NET_OpenPrivateSocket
+
+Opens UDP socket bound to random port that is not managed by NET_Config.
+Used by the load generator to give each simulated client its own address.
+====================
+*/
+qsocket_t NET_OpenPrivateSocket(netadrtype_t type)
+{
+    ioentry_t *e;
+    qsocket_t s;
+
+    if (type == NA_IP6)
+        s = UDP_OpenSocket(net_ip6->string, PORT_ANY, AF_INET6);
+    else
+        s = UDP_OpenSocket(net_ip->string, PORT_ANY, AF_INET);
+    if (s == -1)
+        return -1;
+
+    e = NET_AddFd(s);
+    e->wantread = true;
+    return s;
+}
+
+void NET_ClosePrivateSocket(qsocket_t s)
+{
+    if (s == -1)
+        return;
+
+    NET_RemoveFd(s);
+    os_closesocket(s);
+}
+
+// returns number of bytes read, NET_AGAIN or NET_ERROR
+int NET_RecvPrivate(qsocket_t s, void *data, size_t len, netadr_t *from)
+{
+    ioentry_t *e = os_get_io(s);
+    int ret;
+
+    if (!e->canread)
+        return NET_AGAIN;
+
+    ret = os_udp_recv(s, data, len, from);
+    if (ret == NET_AGAIN)
+        e->canread = false;
+    return ret;
+}
+
+bool NET_SendPrivatev(qsocket_t s, const netvec_t *vec, int count, const netadr_t *to)
+{
+    size_t len = 0;
+    int i;
+
+    for (i = 0; i < count; i++)
+        len += vec[i].len;
+
+    return os_udp_sendv(s, vec, count, to) == (int)len;
+}
+
+bool NET_SendPrivate(qsocket_t s, const void *data, size_t len, const netadr_t *to)
+{
+    netvec_t vec = { data, len };
+
+    return NET_SendPrivatev(s, &vec, 1, to);
+}
+
+#endif // USE_LOADGEN
+
 /*
 ====================
 NET_Config
@@ -1315,6 +1951,11 @@ void NET_Config(netflag_t flag)
         return;
     }
 
+#if USE_MMSG
+    // sockets may be closed below, drop anything still queued
+    net_sendcount = 0;
+#endif
+
     if (flag == NET_NONE) {
         // shut down any existing sockets
         for (sock = 0; sock < NS_COUNT; sock++) {
@@ -1961,6 +2602,26 @@ void NET_Init(void)
     net_ignore_icmp = Cvar_Get("net_ignore_icmp", "0", 0);
 #endif
 
+#if USE_MMSG
+    net_batch = Cvar_Get("net_batch", "1", 0);
+#endif
+
+    net_sim = Cvar_Get("net_sim", "0", 0);
+    net_sim->changed = net_sim_changed;
+    net_sim_latency = Cvar_Get("net_sim_latency", "0", 0);
+    net_sim_jitter = Cvar_Get("net_sim_jitter", "0", 0);
+    net_sim_loss = Cvar_Get("net_sim_loss", "0", 0);
+    net_sim_burst = Cvar_Get("net_sim_burst", "1", 0);
+    net_sim_burst->changed = net_sim_changed;
+    net_sim_dup = Cvar_Get("net_sim_dup", "0", 0);
+    net_sim_reorder = Cvar_Get("net_sim_reorder", "0", 0);
+    net_sim_seed = Cvar_Get("net_sim_seed", "0", 0);
+    net_sim_seed->changed = net_sim_changed;
+
+    List_Init(&net_simdirs[0].queue);
+    List_Init(&net_simdirs[1].queue);
+    net_sim_changed(net_sim);
+
 #if _DEBUG
     net_log_enable_changed(net_log_enable);
 #endif
@@ -1987,6 +2648,8 @@ void NET_Shutdown(void)
     logfile_close();
 #endif
 
+    NET_SimClear();
+
     NET_Listen(false);
     NET_Config(NET_NONE);
     os_net_shutdown();
@@ -134,19 +134,28 @@ static int os_udp_recv(qsocket_t sock, void *data,
     return NET_ERROR;
 }
 
-static int os_udp_send(qsocket_t sock, const void *data,
-                       size_t len, const netadr_t *to)
+static int os_udp_sendv(qsocket_t sock, const netvec_t *vec,
+                        int count, const netadr_t *to)
 {
     struct sockaddr_storage addr;
-    socklen_t addrlen;
-    int ret;
+    struct iovec iov[NET_MAX_VECS];
+    struct msghdr msg;
+    int i, ret;
     int tries;
 
-    addrlen = NET_NetadrToSockadr(to, &addr);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &addr;
+    msg.msg_namelen = NET_NetadrToSockadr(to, &addr);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+
+    for (i = 0; i < count; i++) {
+        iov[i].iov_base = (void *)vec[i].data;
+        iov[i].iov_len = vec[i].len;
+    }
 
     for (tries = 0; tries < MAX_ERROR_RETRIES; tries++) {
-        ret = sendto(sock, data, len, 0,
-                     (struct sockaddr *)&addr, addrlen);
+        ret = sendmsg(sock, &msg, 0);
         if (ret >= 0)
             return ret;
 
@@ -172,6 +181,72 @@ static neterr_t os_get_error(void)
     return NET_ERROR;
 }
 
+#if USE_MMSG
+
+// receives up to count datagrams with a single syscall.
+// returns number of datagrams received or error code.
+static int os_udp_recv_many(qsocket_t sock, netbatch_t *batch, int count)
+{
+    struct mmsghdr msgs[NET_BATCH_MAX];
+    struct iovec iov[NET_BATCH_MAX];
+    struct sockaddr_storage addr[NET_BATCH_MAX];
+    int i, ret;
+
+    memset(msgs, 0, sizeof(msgs[0]) * count);
+    memset(addr, 0, sizeof(addr[0]) * count);
+    for (i = 0; i < count; i++) {
+        iov[i].iov_base = batch[i].data;
+        iov[i].iov_len = sizeof(batch[i].data);
+        msgs[i].msg_hdr.msg_name = &addr[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(addr[i]);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    ret = recvmmsg(sock, msgs, count, 0, NULL);
+    if (ret == -1)
+        return os_get_error();
+
+    for (i = 0; i < ret; i++) {
+        NET_SockadrToNetadr(&addr[i], &batch[i].adr);
+        batch[i].len = msgs[i].msg_len;
+    }
+
+    return ret;
+}
+
+// sends up to count datagrams with a single syscall.
+// returns number of datagrams sent or error code.
+static int os_udp_send_many(qsocket_t sock, netbatch_t *batch, int count)
+{
+    struct mmsghdr msgs[NET_BATCH_MAX];
+    struct iovec iov[NET_BATCH_MAX];
+    struct sockaddr_storage addr[NET_BATCH_MAX];
+    int i, ret;
+
+    memset(msgs, 0, sizeof(msgs[0]) * count);
+    for (i = 0; i < count; i++) {
+        iov[i].iov_base = batch[i].data;
+        iov[i].iov_len = batch[i].len;
+        msgs[i].msg_hdr.msg_name = &addr[i];
+        msgs[i].msg_hdr.msg_namelen = NET_NetadrToSockadr(&batch[i].adr, &addr[i]);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    ret = sendmmsg(sock, msgs, count, 0);
+    if (ret == -1)
+        return os_get_error();
+
+    for (i = 0; i < ret; i++) {
+        batch[i].len = msgs[i].msg_len;
+    }
+
+    return ret;
+}
+
+#endif // USE_MMSG
+
 static int os_recv(qsocket_t sock, void *data, size_t len, int flags)
 {
     int ret = recv(sock, data, len, flags);
@@ -318,19 +393,112 @@ static qsocket_t os_socket(int domain, int type, int protocol)
 
 static ioentry_t *_os_get_io(qsocket_t fd, const char *func)
 {
-    if (fd < 0 || fd >= FD_SETSIZE)
+    if (fd < 0 || fd >= MAX_IO_ENTRIES)
         Com_Error(ERR_FATAL, "%s: fd out of range: %d", func, fd);
 
     return &io_entries[fd];
 }
 
+#if USE_EPOLL
+
+#define MAX_POLL_EVENTS     256
+
+static int  os_epoll_fd = -1;
+
+// descriptor is watched for all events in edge-triggered mode, since
+// callers are free to change wantread/wantwrite flags at any time
+static void os_epoll_add(qsocket_t fd, ioentry_t *e)
+{
+    struct epoll_event ev;
+
+    // may be called before NET_Init for stdin
+    if (os_epoll_fd == -1) {
+        os_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (os_epoll_fd == -1)
+            Com_Error(ERR_FATAL, "%s: %s", __func__, strerror(errno));
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLET;
+    ev.data.fd = fd;
+
+    if (epoll_ctl(os_epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0)
+        return;
+
+    if (errno == EPERM) {
+        // regular files can't be polled, but are always ready
+        e->canread = true;
+        e->canwrite = true;
+        return;
+    }
+
+    if (errno != EEXIST)
+        Com_EPrintf("%s: %s\n", __func__, strerror(errno));
+}
+
+static void os_remove_io(qsocket_t fd)
+{
+    if (os_epoll_fd != -1)
+        epoll_ctl(os_epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+static int os_poll(int msec)
+{
+    struct epoll_event events[MAX_POLL_EVENTS];
+    ioentry_t *e;
+    int i, ret;
+
+    // no new edge will be reported for descriptors that weren't drained
+    // by consumer, don't block if any of them is still wanted
+    for (i = 0, e = io_entries; msec && i < io_numfds; i++, e++) {
+        if (!e->inuse)
+            continue;
+        if ((e->wantread && e->canread) ||
+            (e->wantwrite && e->canwrite) ||
+            (e->wantexcept && e->canexcept))
+            msec = 0;
+    }
+
+    ret = epoll_wait(os_epoll_fd, events, MAX_POLL_EVENTS, msec);
+    if (ret == -1) {
+        net_error = errno;
+        if (net_error == EINTR)
+            return 0;
+        Com_EPrintf("%s: %s\n", __func__, strerror(net_error));
+        return ret;
+    }
+
+    for (i = 0; i < ret; i++) {
+        e = &io_entries[events[i].data.fd];
+        if (!e->inuse)
+            continue;
+        if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            e->canread = true;
+        if (events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+            e->canwrite = true;
+        if (events[i].events & (EPOLLPRI | EPOLLERR))
+            e->canexcept = true;
+    }
+
+    return ret;
+}
+
+#endif // USE_EPOLL
+
 static ioentry_t *os_add_io(qsocket_t fd)
 {
+    ioentry_t *e = _os_get_io(fd, __func__);
+
+#if USE_EPOLL
+    if (!e->inuse)
+        os_epoll_add(fd, e);
+#endif
+
     if (fd >= io_numfds) {
         io_numfds = fd + 1;
     }
 
-    return _os_get_io(fd, __func__);
+    return e;
 }
 
 static ioentry_t *os_get_io(qsocket_t fd)
@@ -338,6 +506,8 @@ static ioentry_t *os_get_io(qsocket_t fd)
     return _os_get_io(fd, __func__);
 }
 
+#if !USE_EPOLL
+
 static qsocket_t os_get_fd(ioentry_t *e)
 {
     return e - io_entries;
@@ -357,10 +527,18 @@ static int os_select(int nfds, fd_set *rfds, fd_set *wfds,
     return ret;
 }
 
+#endif // !USE_EPOLL
+
 static void os_net_init(void)
 {
 }
 
 static void os_net_shutdown(void)
 {
+#if USE_EPOLL
+    if (os_epoll_fd != -1) {
+        close(os_epoll_fd);
+        os_epoll_fd = -1;
+    }
+#endif
 }
@@ -142,20 +142,25 @@ static int os_udp_recv(qsocket_t sock, void *data,
     return NET_ERROR;
 }
 
-static int os_udp_send(qsocket_t sock, const void *data,
-                       size_t len, const netadr_t *to)
+static int os_udp_sendv(qsocket_t sock, const netvec_t *vec,
+                        int count, const netadr_t *to)
 {
     struct sockaddr_storage addr;
+    WSABUF bufs[NET_MAX_VECS];
+    DWORD sent;
     int addrlen;
-    int ret;
+    int i;
 
     addrlen = NET_NetadrToSockadr(to, &addr);
 
-    ret = sendto(sock, data, len, 0,
-                 (struct sockaddr *)&addr, addrlen);
+    for (i = 0; i < count; i++) {
+        bufs[i].buf = (char *)vec[i].data;
+        bufs[i].len = vec[i].len;
+    }
 
-    if (ret != SOCKET_ERROR)
-        return ret;
+    if (WSASendTo(sock, bufs, count, &sent, 0, (struct sockaddr *)&addr,
+                  addrlen, NULL, NULL) != SOCKET_ERROR)
+        return sent;
 
     net_error = WSAGetLastError();
 
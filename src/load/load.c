@@ -0,0 +1,980 @@
+/*
+Copyright (C) 2026 Q2PRO contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+//
+// load.c -- headless load generator
+//
+// Takes place of the server in q2proload build. Connects a number of
+// simulated protocol 34 clients to a server and feeds them usercmds.
+// Each client needs its own UDP port, because server tells clients apart
+// by address, so instead of the global netchan sockets every client owns
+// a private socket that its netchan sends through.
+//
+
+#include "shared/shared.h"
+#include "common/cmd.h"
+#include "common/common.h"
+#include "common/cvar.h"
+#include "common/msg.h"
+#include "common/net/chan.h"
+#include "common/net/net.h"
+#include "common/protocol.h"
+#include "common/sizebuf.h"
+#include "common/zone.h"
+#include "server/server.h"
+#include "system/system.h"
+
+#define LOAD_MAX_CLIENTS    1024
+#define LOAD_RESEND         1000    // msec between connection attempts
+#define LOAD_TIMEOUT        30000   // msec of silence before giving up
+#define LOAD_MAX_INTERVAL   1000    // range of frame interval histogram
+
+typedef enum {
+    lc_disconnected,
+    lc_challenging,     // sending getchallenge
+    lc_connecting,      // sending connect
+    lc_connected,       // netchan established, loading
+    lc_spawned,         // sent begin, sending usercmds, waiting for first frame
+    lc_active           // receiving frames, sending usercmds
+} lcstate_t;
+
+typedef struct {
+    lcstate_t   state;
+    int         number;
+    qsocket_t   sock;
+    int         qport;
+    int         challenge;
+    unsigned    connect_time;
+    unsigned    last_received;
+
+    netchan_t   *netchan;
+    unsigned    sent_time[CMD_BACKUP];  // for ping calculation
+
+    // frames received, for delta compression
+    int         frames[UPDATE_BACKUP];
+    int         validframe;     // last valid frame, -1 if none
+    int         lastframe;      // last frame received, -1 if none
+    unsigned    lastframe_time;
+
+    // movement
+    usercmd_t   cmds[CMD_BACKUP];
+    unsigned    cmdnum;
+    unsigned    cmd_time;
+    unsigned    next_cmd;
+    unsigned    next_move;
+    usercmd_t   move;
+    float       yaw;
+    float       yawspeed;
+
+    // statistics since last reset
+    unsigned    frames_rcvd;
+    unsigned    frames_lost;
+    unsigned    frames_nodelta;
+    unsigned    frames_suppressed;
+    unsigned    packets_dropped;
+    unsigned    ping_total;
+    unsigned    ping_count;
+    unsigned    ping_min;
+    unsigned    ping_max;
+    uint64_t    bytes_rcvd;
+    uint64_t    bytes_sent;
+} loadclient_t;
+
+static struct {
+    loadclient_t    *clients;
+    int             numclients;
+    netadr_t        address;
+    qsocket_t       rcon_sock;
+    unsigned        realtime;
+    unsigned        reset_time;
+    unsigned        report_time;
+    unsigned        intervals[LOAD_MAX_INTERVAL + 1];   // frame interval histogram
+} load = { .rcon_sock = -1 };
+
+static cvar_t   *load_server;
+static cvar_t   *load_clients;
+static cvar_t   *load_cmdrate;
+static cvar_t   *load_moves;
+static cvar_t   *load_report;
+static cvar_t   *load_rcon_password;
+
+/*
+==============================================================================
+
+NETWORK
+
+==============================================================================
+*/
+
+static void send_oob(qsocket_t sock, const char *fmt, ...) q_printf(2, 3);
+
+static void send_oob(qsocket_t sock, const char *fmt, ...)
+{
+    char buffer[MAX_PACKETLEN_DEFAULT];
+    va_list argptr;
+    size_t len;
+
+    memcpy(buffer, "\xff\xff\xff\xff", 4);
+
+    va_start(argptr, fmt);
+    len = Q_vsnprintf(buffer + 4, sizeof(buffer) - 4, fmt, argptr);
+    va_end(argptr);
+
+    if (len >= sizeof(buffer) - 4) {
+        Com_WPrintf("%s: overflow\n", __func__);
+        return;
+    }
+
+    NET_SendPrivate(sock, buffer, len + 4, &load.address);
+}
+
+static void drop_client(loadclient_t *cl, const char *reason)
+{
+    if (cl->state == lc_disconnected)
+        return;
+
+    Com_Printf("load%03d: %s\n", cl->number, reason);
+    cl->state = lc_disconnected;
+}
+
+static void setup_netchan(loadclient_t *cl)
+{
+    if (cl->netchan)
+        Netchan_Close(cl->netchan);
+
+    cl->netchan = Netchan_Setup(NS_CLIENT, NETCHAN_OLD, &load.address, cl->qport,
+                                MAX_PACKETLEN_WRITABLE_DEFAULT, PROTOCOL_VERSION_DEFAULT);
+    cl->netchan->privsock = cl->sock;
+
+    // overflow is checked by netchan before transmitting
+    cl->netchan->message.allowoverflow = true;
+}
+
+static void add_stringcmd(loadclient_t *cl, const char *s)
+{
+    MSG_WriteByte(clc_stringcmd);
+    MSG_WriteString(s);
+    MSG_FlushTo(&cl->netchan->message);
+}
+
+// transmits unreliable data along with pending reliable message
+static void transmit(loadclient_t *cl, const void *data, size_t length, int numpackets)
+{
+    netchan_t *netchan = cl->netchan;
+
+    cl->sent_time[netchan->outgoing_sequence & CMD_MASK] = load.realtime;
+    cl->bytes_sent += netchan->Transmit(netchan, length, data, numpackets);
+
+    if (netchan->fatal_error)
+        drop_client(cl, "outgoing message overflow");
+}
+
+// returns false if packet should be discarded
+static bool process_netchan(loadclient_t *cl)
+{
+    netchan_t *netchan = cl->netchan;
+    int acknowledged = netchan->incoming_acknowledged;
+    unsigned ping;
+
+    if (!netchan->Process(netchan))
+        return false;
+
+    cl->packets_dropped += netchan->dropped;
+
+    // round trip time of the newest acknowledged packet
+    if (netchan->incoming_acknowledged > acknowledged &&
+        netchan->incoming_acknowledged < netchan->outgoing_sequence &&
+        netchan->outgoing_sequence - netchan->incoming_acknowledged < CMD_BACKUP) {
+        ping = load.realtime - cl->sent_time[netchan->incoming_acknowledged & CMD_MASK];
+        cl->ping_total += ping;
+        cl->ping_count++;
+        cl->ping_min = min(cl->ping_min, ping);
+        cl->ping_max = max(cl->ping_max, ping);
+    }
+
+    cl->last_received = load.realtime;
+    return true;
+}
+
+/*
+==============================================================================
+
+PARSING
+
+Server message is read with the same MSG_Parse* functions client uses,
+but only frame numbers are tracked.
+
+==============================================================================
+*/
+
+static void parse_stufftext(loadclient_t *cl)
+{
+    char buffer[MAX_STRING_CHARS];
+    char *s, *p;
+
+    MSG_ReadString(buffer, sizeof(buffer));
+
+    for (s = buffer; *s; s = p) {
+        p = strchr(s, '\n');
+        if (p)
+            *p++ = 0;
+        else
+            p = s + strlen(s);
+
+        // expand $version and the like from local cvars
+        Cmd_TokenizeString(s, true);
+
+        if (!strcmp(Cmd_Argv(0), "cmd")) {
+            if (Cmd_Argc() > 1)
+                add_stringcmd(cl, Cmd_RawArgs());
+        } else if (!strcmp(Cmd_Argv(0), "precache")) {
+            add_stringcmd(cl, va("begin %s", Cmd_Argv(1)));
+            // start moving right away, like a player would. the first
+            // uncompressed frame may not fit into 1390 bytes when many
+            // clients spawn at the same spot, moving apart fixes that.
+            cl->state = lc_spawned;
+            cl->cmd_time = load.realtime;
+        } else if (!strcmp(Cmd_Argv(0), "changing")) {
+            cl->state = lc_connected;
+        } else if (!strcmp(Cmd_Argv(0), "reconnect")) {
+            cl->state = lc_connected;
+            add_stringcmd(cl, "new");
+        } else if (!strcmp(Cmd_Argv(0), "disconnect")) {
+            drop_client(cl, "disconnected by server");
+        }
+    }
+}
+
+static void parse_serverdata(loadclient_t *cl)
+{
+    int i, protocol;
+
+    protocol = MSG_ReadLong();
+    MSG_ReadLong();             // servercount
+    MSG_ReadByte();             // attractloop
+    MSG_ReadString(NULL, 0);    // gamedir
+    MSG_ReadShort();            // clientnum
+    MSG_ReadString(NULL, 0);    // levelname
+
+    if (protocol != PROTOCOL_VERSION_DEFAULT) {
+        drop_client(cl, va("unsupported protocol %d", protocol));
+        return;
+    }
+
+    for (i = 0; i < UPDATE_BACKUP; i++)
+        cl->frames[i] = -1;
+    cl->validframe = cl->lastframe = -1;
+    cl->state = lc_connected;
+}
+
+static void parse_frame(loadclient_t *cl)
+{
+    static entity_state_t   es;
+    static player_state_t   ps;
+    int currentframe, deltaframe, suppressed, length, bits, number;
+    unsigned interval;
+    bool valid;
+
+    currentframe = MSG_ReadLong();
+    deltaframe = MSG_ReadLong();
+    suppressed = MSG_ReadByte();
+    length = MSG_ReadByte();
+    MSG_ReadData(length);   // areabits
+
+    if (MSG_ReadByte() != svc_playerinfo)
+        goto bad;
+    MSG_ParseDeltaPlayerstate_Default(NULL, &ps, MSG_ReadWord());
+
+    if (MSG_ReadByte() != svc_packetentities)
+        goto bad;
+    while (1) {
+        number = MSG_ParseEntityBits(&bits);
+        if (number < 0 || number >= MAX_EDICTS)
+            goto bad;
+        if (!number)
+            break;
+        if (!(bits & U_REMOVE))
+            MSG_ParseDeltaEntity(NULL, &es, number, bits, 0);
+    }
+
+    if (msg_read.readcount > msg_read.cursize)
+        return;
+
+    if (currentframe <= cl->lastframe)
+        return;
+
+    // entities are not tracked, but delta chain is
+    if (deltaframe <= 0) {
+        cl->frames_nodelta++;
+        valid = true;
+    } else {
+        valid = cl->frames[deltaframe & UPDATE_MASK] == deltaframe;
+    }
+
+    if (cl->lastframe != -1) {
+        cl->frames_lost += currentframe - cl->lastframe - 1;
+        interval = min(load.realtime - cl->lastframe_time, LOAD_MAX_INTERVAL);
+        load.intervals[interval]++;
+    }
+
+    cl->frames[currentframe & UPDATE_MASK] = valid ? currentframe : -1;
+    cl->validframe = valid ? currentframe : -1;
+    cl->lastframe = currentframe;
+    cl->lastframe_time = load.realtime;
+    cl->frames_rcvd++;
+    cl->frames_suppressed += suppressed;
+
+    if (cl->state < lc_active) {
+        Com_DPrintf("load%03d: entered the game\n", cl->number);
+        cl->state = lc_active;
+    }
+    return;
+
+bad:
+    msg_read.readcount = msg_read.cursize + 1;
+}
+
+static void parse_message(loadclient_t *cl)
+{
+    char buffer[MAX_STRING_CHARS];
+    int cmd, bits, number;
+    entity_state_t es;
+    tent_params_t te;
+    snd_params_t snd;
+
+    while (cl->state >= lc_connected) {
+        if (msg_read.readcount >= msg_read.cursize)
+            break;
+
+        cmd = MSG_ReadByte();
+        switch (cmd) {
+        case svc_nop:
+            break;
+        case svc_muzzleflash:
+        case svc_muzzleflash2:
+            MSG_ReadData(3);
+            break;
+        case svc_temp_entity:
+            if (!MSG_ParseTEntPacket(&te))
+                goto bad;
+            break;
+        case svc_sound:
+            MSG_ParseStartSoundPacket(&snd);
+            break;
+        case svc_layout:
+        case svc_centerprint:
+            MSG_ReadString(NULL, 0);
+            break;
+        case svc_inventory:
+            MSG_ReadData(MAX_ITEMS * 2);
+            break;
+        case svc_print:
+            MSG_ReadByte();
+            MSG_ReadString(buffer, sizeof(buffer));
+            Com_DPrintf("load%03d: %s", cl->number, buffer);
+            break;
+        case svc_stufftext:
+            parse_stufftext(cl);
+            break;
+        case svc_serverdata:
+            parse_serverdata(cl);
+            break;
+        case svc_configstring:
+            MSG_ReadShort();
+            MSG_ReadString(NULL, 0);
+            break;
+        case svc_spawnbaseline:
+            number = MSG_ParseEntityBits(&bits);
+            if (number < 1 || number >= MAX_EDICTS)
+                goto bad;
+            MSG_ParseDeltaEntity(NULL, &es, number, bits, 0);
+            break;
+        case svc_frame:
+            parse_frame(cl);
+            break;
+        case svc_disconnect:
+            drop_client(cl, "server disconnected");
+            return;
+        case svc_reconnect:
+            cl->state = lc_challenging;
+            cl->connect_time = load.realtime - LOAD_RESEND;
+            return;
+        default:
+            goto bad;
+        }
+
+        if (msg_read.readcount > msg_read.cursize)
+            goto bad;
+    }
+
+    return;
+
+bad:
+    drop_client(cl, va("bad server message %d", cmd));
+}
+
+static void parse_oob(loadclient_t *cl)
+{
+    char buffer[MAX_STRING_CHARS];
+
+    MSG_ReadLong();     // skip the -1 marker
+    MSG_ReadStringLine(buffer, sizeof(buffer));
+    Cmd_TokenizeString(buffer, false);
+
+    if (!strcmp(Cmd_Argv(0), "challenge")) {
+        if (cl->state != lc_challenging)
+            return;
+        cl->challenge = atoi(Cmd_Argv(1));
+        cl->state = lc_connecting;
+        cl->connect_time = load.realtime - LOAD_RESEND;  // send immediately
+    } else if (!strcmp(Cmd_Argv(0), "client_connect")) {
+        if (cl->state != lc_connecting)
+            return;
+        setup_netchan(cl);
+        add_stringcmd(cl, "new");
+        cl->state = lc_connected;
+        cl->last_received = load.realtime;
+        cl->next_cmd = load.realtime;
+    } else if (!strcmp(Cmd_Argv(0), "print")) {
+        if (cl->state != lc_connecting)
+            return;
+        // connection refused
+        MSG_ReadStringLine(buffer, sizeof(buffer));
+        drop_client(cl, buffer);
+    }
+}
+
+static void read_packets(loadclient_t *cl)
+{
+    netadr_t from;
+    int ret;
+
+    while (1) {
+        ret = NET_RecvPrivate(cl->sock, msg_read_buffer, MAX_PACKETLEN, &from);
+        if (ret == NET_AGAIN)
+            break;
+        if (ret == NET_ERROR) {
+            Com_DPrintf("load%03d: %s\n", cl->number, NET_ErrorString());
+            break;
+        }
+        if (!NET_IsEqualAdr(&from, &load.address))
+            continue;
+
+        msg_read.cursize = ret;
+        MSG_BeginReading();
+
+        cl->bytes_rcvd += ret;
+
+        if (ret >= 4 && *(int32_t *)msg_read.data == -1) {
+            parse_oob(cl);
+            continue;
+        }
+
+        if (cl->state < lc_connected || ret < 8)
+            continue;
+
+        if (!process_netchan(cl))
+            continue;
+
+        parse_message(cl);
+    }
+}
+
+static void read_rcon(void)
+{
+    char buffer[MAX_PACKETLEN];
+    netadr_t from;
+    int ret;
+
+    while (1) {
+        ret = NET_RecvPrivate(load.rcon_sock, buffer, sizeof(buffer) - 1, &from);
+        if (ret == NET_AGAIN || ret == NET_ERROR)
+            break;
+        if (ret < 10 || memcmp(buffer, "\xff\xff\xff\xffprint\n", 10))
+            continue;
+        buffer[ret] = 0;
+        Com_Printf("%s", buffer + 10);
+    }
+}
+
+static void send_rcon(const char *cmd)
+{
+    if (load.rcon_sock != -1)
+        send_oob(load.rcon_sock, "rcon \"%s\" %s", load_rcon_password->string, cmd);
+}
+
+/*
+==============================================================================
+
+MOVEMENT
+
+==============================================================================
+*/
+
+static void build_cmd(loadclient_t *cl, usercmd_t *cmd, unsigned msec)
+{
+    usercmd_t *move = &cl->move;
+
+    switch (load_moves->integer) {
+    case 0:
+        // stand still
+        memset(move, 0, sizeof(*move));
+        cl->yawspeed = 0;
+        break;
+    case 1:
+        // run in circles, firing every other second
+        move->forwardmove = 400;
+        move->sidemove = 0;
+        move->upmove = 0;
+        move->buttons = ((load.realtime / 1000 + cl->number) & 1) ? BUTTON_ATTACK : 0;
+        if (!cl->yawspeed)
+            cl->yawspeed = (cl->number & 1) ? 90 : -90;
+        break;
+    default:
+        // change random direction, buttons and turning speed now and then
+        if (load.realtime >= cl->next_move) {
+            move->forwardmove = ((int)Q_rand_uniform(3) - 1) * 400;
+            move->sidemove = ((int)Q_rand_uniform(3) - 1) * 400;
+            move->upmove = Q_rand_uniform(8) ? 0 : 400;
+            move->buttons = Q_rand_uniform(4) ? 0 : BUTTON_ATTACK;
+            cl->yawspeed = crand() * 360;
+            cl->next_move = load.realtime + 250 + Q_rand_uniform(1000);
+        }
+        break;
+    }
+
+    cl->yaw = anglemod(cl->yaw + cl->yawspeed * msec * 0.001f);
+
+    *cmd = *move;
+    cmd->msec = msec;
+    cmd->angles[YAW] = ANGLE2SHORT(cl->yaw);
+}
+
+static void send_cmd(loadclient_t *cl)
+{
+    usercmd_t *cmd, *oldcmd;
+    unsigned msec;
+    int i;
+
+    msec = load.realtime - cl->cmd_time;
+    clamp(msec, 1, 250);
+    cl->cmd_time = load.realtime;
+
+    cl->cmdnum++;
+    build_cmd(cl, &cl->cmds[cl->cmdnum & CMD_MASK], msec);
+
+    MSG_WriteByte(clc_move);
+    MSG_WriteByte(0);   // checksum is not verified by server
+    MSG_WriteLong(cl->validframe);
+
+    // send this and the previous cmds in the message, so
+    // if the last packet was dropped, it can be recovered
+    oldcmd = NULL;
+    for (i = 2; i >= 0; i--) {
+        cmd = &cl->cmds[(cl->cmdnum - i) & CMD_MASK];
+        MSG_WriteDeltaUsercmd(oldcmd, cmd, 0);
+        MSG_WriteByte(0);   // lightlevel
+        oldcmd = cmd;
+    }
+
+    transmit(cl, msg_write.data, msg_write.cursize, 1);
+    SZ_Clear(&msg_write);
+}
+
+// returns msec until client needs to be run again
+static unsigned run_client(loadclient_t *cl)
+{
+    unsigned interval = 1000 / Cvar_ClampInteger(load_cmdrate, 1, 1000);
+
+    switch (cl->state) {
+    case lc_disconnected:
+        return LOAD_RESEND;
+
+    case lc_challenging:
+    case lc_connecting:
+        if (load.realtime - cl->connect_time < LOAD_RESEND)
+            return cl->connect_time + LOAD_RESEND - load.realtime;
+
+        if (load.realtime - cl->last_received > LOAD_TIMEOUT) {
+            drop_client(cl, "connection timed out");
+            return LOAD_RESEND;
+        }
+
+        if (cl->state == lc_challenging)
+            send_oob(cl->sock, "getchallenge\n");
+        else
+            send_oob(cl->sock, "connect %d %d %d \"\\name\\load%03d\\rate\\25000\\msg\\1"
+                     "\\hand\\2\\fov\\90\\skin\\male/grunt\"\n", PROTOCOL_VERSION_DEFAULT,
+                     cl->qport, cl->challenge, cl->number);
+        cl->connect_time = load.realtime;
+        return LOAD_RESEND;
+
+    default:
+        if (load.realtime - cl->last_received > LOAD_TIMEOUT) {
+            drop_client(cl, "server timed out");
+            return LOAD_RESEND;
+        }
+
+        if ((int)(cl->next_cmd - load.realtime) > 0)
+            return cl->next_cmd - load.realtime;
+
+        if (cl->state >= lc_spawned)
+            send_cmd(cl);
+        else if (cl->netchan->ShouldUpdate(cl->netchan))
+            transmit(cl, NULL, 0, 1);
+
+        cl->next_cmd += interval;
+        if ((int)(cl->next_cmd - load.realtime) <= 0)
+            cl->next_cmd = load.realtime + interval;
+        return cl->next_cmd - load.realtime;
+    }
+}
+
+/*
+==============================================================================
+
+STATISTICS
+
+==============================================================================
+*/
+
+static void reset_stats(void)
+{
+    loadclient_t *cl;
+    int i;
+
+    for (i = 0, cl = load.clients; i < load.numclients; i++, cl++) {
+        cl->frames_rcvd = cl->frames_lost = 0;
+        cl->frames_nodelta = cl->frames_suppressed = 0;
+        cl->packets_dropped = 0;
+        cl->ping_total = cl->ping_count = cl->ping_max = 0;
+        cl->ping_min = UINT_MAX;
+        cl->bytes_rcvd = cl->bytes_sent = 0;
+    }
+
+    memset(load.intervals, 0, sizeof(load.intervals));
+    load.reset_time = load.realtime;
+}
+
+// returns smallest interval that given fraction of frames fits into
+static unsigned interval_percentile(unsigned total, unsigned percent)
+{
+    unsigned i, count = 0, need = (total * percent + 99) / 100;
+
+    for (i = 0; i < LOAD_MAX_INTERVAL; i++) {
+        count += load.intervals[i];
+        if (count >= need)
+            break;
+    }
+
+    return i;
+}
+
+static const char *state_names[] = {
+    "dropped", "chllnge", "connect", "loading", "spawned", "active"
+};
+
+static void print_summary(bool verbose, bool reset)
+{
+    loadclient_t *cl;
+    unsigned active = 0, frames = 0, lost = 0, nodelta = 0, suppressed = 0;
+    unsigned dropped = 0, ping_total = 0, ping_count = 0, ping_min = UINT_MAX, ping_max = 0;
+    unsigned total = 0, highest = 0;
+    uint64_t rcvd = 0, sent = 0;
+    float sec = max(load.realtime - load.reset_time, 1) * 0.001f;
+    int i;
+
+    if (verbose) {
+        Com_Printf(
+            "num state   ping  min  max frames  lost nodlt suppr  drop  in/s out/s\n"
+            "--- ------- ---- ---- ---- ------ ----- ----- ----- ----- ----- -----\n");
+    }
+
+    for (i = 0, cl = load.clients; i < load.numclients; i++, cl++) {
+        if (verbose) {
+            Com_Printf("%3d %-7s %4u %4u %4u %6u %5u %5u %5u %5u %5.f %5.f\n",
+                       cl->number, state_names[cl->state],
+                       cl->ping_count ? cl->ping_total / cl->ping_count : 0,
+                       cl->ping_count ? cl->ping_min : 0, cl->ping_max,
+                       cl->frames_rcvd, cl->frames_lost, cl->frames_nodelta,
+                       cl->frames_suppressed, cl->packets_dropped,
+                       cl->bytes_rcvd / sec, cl->bytes_sent / sec);
+        }
+
+        active += cl->state == lc_active;
+        frames += cl->frames_rcvd;
+        lost += cl->frames_lost;
+        nodelta += cl->frames_nodelta;
+        suppressed += cl->frames_suppressed;
+        dropped += cl->packets_dropped;
+        ping_total += cl->ping_total;
+        ping_count += cl->ping_count;
+        if (cl->ping_count)
+            ping_min = min(ping_min, cl->ping_min);
+        ping_max = max(ping_max, cl->ping_max);
+        rcvd += cl->bytes_rcvd;
+        sent += cl->bytes_sent;
+    }
+
+    for (i = 0; i <= LOAD_MAX_INTERVAL; i++) {
+        total += load.intervals[i];
+        if (load.intervals[i])
+            highest = i;
+    }
+
+    Com_Printf("%d/%d active over %.1f sec: ping %u/%u/%u, "
+               "%u frames, %u lost, %u nodelta, %u suppressed, %u dropped, "
+               "%.1f/%.1f kB/s in/out\n",
+               active, load.numclients, sec,
+               ping_count ? ping_min : 0, ping_count ? ping_total / ping_count : 0, ping_max,
+               frames, lost, nodelta, suppressed, dropped,
+               rcvd / sec / 1000, sent / sec / 1000);
+
+    if (total) {
+        Com_Printf("Frame interval (msec): p50 %u, p90 %u, p99 %u, max %u%s\n",
+                   interval_percentile(total, 50), interval_percentile(total, 90),
+                   interval_percentile(total, 99), highest,
+                   highest == LOAD_MAX_INTERVAL ? "+" : "");
+    }
+
+    // server frame time distribution comes from server's own profiler
+    send_rcon("sv_profile");
+    if (reset) {
+        send_rcon("sv_profile reset");
+        reset_stats();
+    }
+}
+
+/*
+==============================================================================
+
+COMMANDS
+
+==============================================================================
+*/
+
+static void stop_load(void)
+{
+    loadclient_t *cl;
+    int i;
+
+    if (!load.clients)
+        return;
+
+    for (i = 0, cl = load.clients; i < load.numclients; i++, cl++) {
+        if (cl->state >= lc_connected) {
+            // send it a few times in case one is dropped
+            MSG_WriteByte(clc_stringcmd);
+            MSG_WriteString("disconnect");
+            transmit(cl, msg_write.data, msg_write.cursize, 3);
+            SZ_Clear(&msg_write);
+        }
+        if (cl->netchan)
+            Netchan_Close(cl->netchan);
+        NET_ClosePrivateSocket(cl->sock);
+    }
+
+    send_rcon("sv_profile stop");
+    NET_ClosePrivateSocket(load.rcon_sock);
+    load.rcon_sock = -1;
+
+    Z_Free(load.clients);
+    load.clients = NULL;
+    load.numclients = 0;
+
+#if USE_SYSCON
+    SV_SetConsoleTitle();
+#endif
+}
+
+static void Load_Start_f(void)
+{
+    loadclient_t *cl;
+    const char *server;
+    int i, count;
+
+    if (Cmd_Argc() > 3) {
+        Com_Printf("Usage: %s [count] [server]\n", Cmd_Argv(0));
+        return;
+    }
+
+    count = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : load_clients->integer;
+    server = Cmd_Argc() > 2 ? Cmd_Argv(2) : load_server->string;
+
+    if (count < 1 || count > LOAD_MAX_CLIENTS) {
+        Com_Printf("Number of clients must be between 1 and %d.\n", LOAD_MAX_CLIENTS);
+        return;
+    }
+
+    stop_load();
+
+    if (!NET_StringToAdr(server, &load.address, PORT_SERVER)) {
+        Com_Printf("Bad server address: %s\n", server);
+        return;
+    }
+
+    load.realtime = Sys_Milliseconds();
+    load.clients = Z_TagMallocz(sizeof(load.clients[0]) * count, TAG_SERVER);
+
+    for (i = 0, cl = load.clients; i < count; i++, cl++) {
+        cl->sock = NET_OpenPrivateSocket(load.address.type);
+        if (cl->sock == -1)
+            break;
+        cl->number = i;
+        cl->qport = Q_rand() & 0xffff;
+        cl->state = lc_challenging;
+        // spread connection attempts over the first second
+        cl->connect_time = load.realtime - LOAD_RESEND + Q_rand_uniform(LOAD_RESEND);
+        cl->last_received = load.realtime;
+    }
+
+    load.numclients = i;
+    if (!load.numclients) {
+        Com_EPrintf("Couldn't open client sockets.\n");
+        stop_load();
+        return;
+    }
+
+    if (load_rcon_password->string[0]) {
+        load.rcon_sock = NET_OpenPrivateSocket(load.address.type);
+        send_rcon("sv_profile start");
+    }
+
+    reset_stats();
+    load.report_time = load.realtime;
+
+    Com_Printf("Starting %d clients to %s\n", load.numclients,
+               NET_AdrToString(&load.address));
+
+#if USE_SYSCON
+    SV_SetConsoleTitle();
+#endif
+}
+
+static void Load_Stop_f(void)
+{
+    if (!load.clients) {
+        Com_Printf("No clients running.\n");
+        return;
+    }
+
+    print_summary(false, false);
+    stop_load();
+}
+
+static void Load_Status_f(void)
+{
+    if (!load.clients) {
+        Com_Printf("No clients running.\n");
+        return;
+    }
+
+    print_summary(true, false);
+}
+
+static void Load_Reset_f(void)
+{
+    reset_stats();
+}
+
+static const cmdreg_t c_load[] = {
+    { "load_start", Load_Start_f },
+    { "load_stop", Load_Stop_f },
+    { "load_status", Load_Status_f },
+    { "load_reset", Load_Reset_f },
+
+    { NULL }
+};
+
+/*
+==============================================================================
+
+SERVER INTERFACE
+
+==============================================================================
+*/
+
+/*
+==================
+SV_Frame
+
+Runs all simulated clients. Returns msec until next usercmd is due.
+==================
+*/
+unsigned SV_Frame(unsigned msec)
+{
+    loadclient_t *cl;
+    unsigned next = 100;
+    int i;
+
+    if (!load.clients)
+        return next;
+
+    load.realtime = Sys_Milliseconds();
+
+    // parser doesn't throw errors on truncated messages
+    msg_read.allowunderflow = true;
+
+    for (i = 0, cl = load.clients; i < load.numclients; i++, cl++) {
+        read_packets(cl);
+        next = min(next, run_client(cl));
+    }
+
+    if (load.rcon_sock != -1)
+        read_rcon();
+
+    if (load_report->integer > 0 &&
+        load.realtime - load.report_time >= load_report->integer * 1000) {
+        print_summary(false, true);
+        load.report_time = load.realtime;
+    }
+
+    return next;
+}
+
+#if USE_SYSCON
+void SV_SetConsoleTitle(void)
+{
+    if (load.clients)
+        Sys_SetConsoleTitle(va("q2proload (%d clients to %s)", load.numclients,
+                               NET_AdrToString(&load.address)));
+    else
+        Sys_SetConsoleTitle("q2proload");
+}
+#endif
+
+void SV_Init(void)
+{
+    Cmd_Register(c_load);
+
+    load_server = Cvar_Get("load_server", "localhost", 0);
+    load_clients = Cvar_Get("load_clients", "16", 0);
+    load_cmdrate = Cvar_Get("load_cmdrate", "30", 0);
+    load_moves = Cvar_Get("load_moves", "1", 0);
+    load_report = Cvar_Get("load_report", "10", 0);
+    load_rcon_password = Cvar_Get("load_rcon_password", "", CVAR_PRIVATE);
+
+#if USE_SYSCON
+    SV_SetConsoleTitle();
+#endif
+}
+
+void SV_Shutdown(const char *finalmsg, error_type_t type)
+{
+    stop_load();
+}
@@ -30,6 +30,69 @@ Encode a client frame onto the network channel
 #define Q2PRO_OPTIMIZE(c) \
     ((c)->protocol == PROTOCOL_VERSION_Q2PRO && !(c)->settings[CLS_RECORDING])
 
+/*
+=============================================================================
+
+Entity delta cache
+
+Clients that acknowledged the same frame usually need identical deltas for
+most entities. Recently encoded deltas are remembered per entity number and
+reused when both states and flags match. Encoding is a pure function of
+these, so entries never need to be invalidated. Cache is per thread, so
+that frames can be encoded on worker threads without locking.
+
+=============================================================================
+*/
+
+// large enough for the longest possible entity delta
+#define DELTA_MAX_BYTES     64
+
+#define DELTA_CACHE_WAYS    2
+
+typedef struct {
+    entity_packed_t from;
+    entity_packed_t to;
+    msgEsFlags_t    flags;
+    int             len;
+    byte            data[DELTA_MAX_BYTES];
+} deltacache_t;
+
+static q_threadlocal deltacache_t   sv_deltacache[MAX_EDICTS][DELTA_CACHE_WAYS];
+static q_threadlocal byte           sv_deltanext[MAX_EDICTS];
+
+static void write_delta_entity(const entity_packed_t *from,
+                               const entity_packed_t *to,
+                               msgEsFlags_t          flags)
+{
+    deltacache_t *c = sv_deltacache[to->number];
+    size_t start, len;
+    int i;
+
+    for (i = 0; i < DELTA_CACHE_WAYS; i++, c++) {
+        if (c->flags == flags &&
+            !memcmp(&c->to, to, sizeof(*to)) &&
+            !memcmp(&c->from, from, sizeof(*from))) {
+            if (c->len)
+                MSG_WriteData(c->data, c->len);
+            return;
+        }
+    }
+
+    start = msg_write.cursize;
+    MSG_WriteDeltaEntity(from, to, flags);
+    len = msg_write.cursize - start;
+    if (len > DELTA_MAX_BYTES || msg_write.overflowed)
+        return;
+
+    i = sv_deltanext[to->number]++ % DELTA_CACHE_WAYS;
+    c = &sv_deltacache[to->number][i];
+    c->from = *from;
+    c->to = *to;
+    c->flags = flags;
+    c->len = len;
+    memcpy(c->data, msg_write.data + start, len);
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -90,7 +153,7 @@ static void SV_EmitPacketEntities(client_t         *client,
             if (Q2PRO_SHORTANGLES(client, newnum)) {
                 flags |= MSG_ES_SHORTANGLES;
             }
-            MSG_WriteDeltaEntity(oldent, newent, flags);
+            write_delta_entity(oldent, newent, flags);
             oldindex++;
             newindex++;
             continue;
@@ -113,7 +176,7 @@ static void SV_EmitPacketEntities(client_t         *client,
             if (Q2PRO_SHORTANGLES(client, newnum)) {
                 flags |= MSG_ES_SHORTANGLES;
             }
-            MSG_WriteDeltaEntity(oldent, newent, flags);
+            write_delta_entity(oldent, newent, flags);
             newindex++;
             continue;
         }
@@ -369,15 +432,260 @@ fix_old_origin(client_t *client, entity_packed_t *state, edict_t *ent, int e)
 }
 #endif
 
+/*
+=============================================================================
+
+Potentially visible entity sets
+
+=============================================================================
+*/
+
+#define LONG_BITS   ((int)sizeof(size_t) * 8)
+
+// entities that may be sent at all this frame
+static byte     sv_frameents[ENT_MASK_BYTES];
+
+// entities that need individual check regardless of cluster index
+static byte     sv_extraents[ENT_MASK_BYTES];
+
+#if USE_MVD_CLIENT
+
+/*
+=============================================================================
+
+Shared frames for MVD spectators
+
+Spectators chasing the same player on a MVD channel usually have identical
+view origins and therefore identical entity sets. Such spectators are
+grouped once per frame: the first one builds entity states as usual and the
+rest reference the same range of svs.entities. Delta encoding from a shared
+range then hits the entity delta cache for every spectator that acked the
+same frame.
+
+Frames are only shared when emitting them can't modify the states, that is
+when the first person entity is not being delta compressed.
+
+=============================================================================
+*/
+
+#define MAX_SHARED_FRAMES   32
+
+typedef struct {
+    const edict_pool_t  *pool;
+    vec3_t      org;
+    int         clientNum;
+    int         flags;
+    client_t    *client;
+} framekey_t;
+
+#define FK_NOGIBS       1
+#define FK_NOFOOTSTEPS  2
+#define FK_OPTIMIZE     4
+#define FK_Q2PRO        8
+
+static int  sv_numsharedframes;
+
+static bool make_frame_key(client_t *client, framekey_t *key)
+{
+    const player_state_t *ps;
+    edict_t *clent = client->edict;
+
+    if (sv.state != ss_broadcast)
+        return false;
+    if (!clent->client)
+        return false;
+
+    ps = &clent->client->ps;
+    if (client->protocol == PROTOCOL_VERSION_Q2PRO &&
+        !client->settings[CLS_RECORDING] && ps->pmove.pm_type < PM_DEAD)
+        return false;
+
+#if USE_FPS
+    if (client->framediv != 1)
+        return false;
+#endif
+
+    key->pool = client->pool;
+    VectorMA(ps->viewoffset, 0.125f, ps->pmove.origin, key->org);
+    if (g_features->integer & GMF_CLIENTNUM)
+        key->clientNum = clent->client->clientNum;
+    else
+        key->clientNum = client->number;
+    key->flags = 0;
+    if (client->settings[CLS_NOGIBS])
+        key->flags |= FK_NOGIBS;
+    if (client->settings[CLS_NOFOOTSTEPS])
+        key->flags |= FK_NOFOOTSTEPS;
+    if (Q2PRO_OPTIMIZE(client))
+        key->flags |= FK_OPTIMIZE;
+    if (client->protocol == PROTOCOL_VERSION_Q2PRO)
+        key->flags |= FK_Q2PRO;
+    key->client = client;
+
+    return true;
+}
+
+// assigns each spectator the first client with identical view, if any
+static void group_client_frames(client_t **clients, int count)
+{
+    framekey_t keys[MAX_SHARED_FRAMES], key;
+    int i, j, numkeys = 0;
+
+    sv_numsharedframes = 0;
+    for (i = 0; i < count; i++) {
+        clients[i]->framesource = NULL;
+        if (!make_frame_key(clients[i], &key))
+            continue;
+
+        for (j = 0; j < numkeys; j++) {
+            if (keys[j].pool == key.pool &&
+                keys[j].clientNum == key.clientNum &&
+                keys[j].flags == key.flags &&
+                VectorCompare(keys[j].org, key.org))
+                break;
+        }
+
+        if (j < numkeys) {
+            clients[i]->framesource = keys[j].client;
+            sv_numsharedframes++;
+        } else if (numkeys < MAX_SHARED_FRAMES) {
+            keys[numkeys++] = key;
+        }
+    }
+}
+
+// copies entity set and areabits built for another spectator this frame
+static void share_client_frame(client_t *client, client_frame_t *frame)
+{
+    client_t *source = client->framesource;
+    client_frame_t *src = &source->frames[source->framenum & UPDATE_MASK];
+
+    frame->areabytes = src->areabytes;
+    memcpy(frame->areabits, src->areabits, src->areabytes);
+    frame->first_entity = src->first_entity;
+    frame->num_entities = src->num_entities;
+}
+
+#endif // USE_MVD_CLIENT
+
+// same filtering as build_client_frame, for entity pools not owned by game
+static void fix_entity_numbers(const edict_pool_t *pool)
+{
+    edict_t *ent;
+    int i;
+
+    for (i = 1; i < pool->num_edicts; i++) {
+        ent = (edict_t *)((byte *)pool->edicts + pool->edict_size * i);
+        if (!ent->inuse && (g_features->integer & GMF_PROPERINUSE))
+            continue;
+        if (ent->svflags & SVF_NOCLIENT)
+            continue;
+        if (!ent->s.modelindex && !ent->s.effects && !ent->s.sound && !ent->s.event)
+            continue;
+        if (ent->s.number != i) {
+            Com_WPrintf("%s: fixing ent->s.number: %d to %d\n",
+                        __func__, ent->s.number, i);
+            ent->s.number = i;
+        }
+    }
+}
+
 /*
 =============
-SV_BuildClientFrame
+SV_PrepareClientFrames
+
+Does client independent entity filtering once per frame, before any
+client frames are built. Also fixes up entity numbers, which can't be done
+safely from worker threads.
+=============
+*/
+void SV_PrepareClientFrames(client_t **clients, int count)
+{
+    edict_t *ent;
+    int i;
+
+    memset(sv_frameents, 0, sizeof(sv_frameents));
+    memset(sv_extraents, 0, sizeof(sv_extraents));
+
+    for (i = 1; sv.state == ss_game && i < ge->num_edicts; i++) {
+        ent = EDICT_NUM(i);
+        if (!ent->inuse && (g_features->integer & GMF_PROPERINUSE))
+            continue;
+        if (ent->svflags & SVF_NOCLIENT)
+            continue;
+        if (!ent->s.modelindex && !ent->s.effects && !ent->s.sound && !ent->s.event)
+            continue;
+        if (ent->s.number != i) {
+            Com_WPrintf("%s: fixing ent->s.number: %d to %d\n",
+                        __func__, ent->s.number, i);
+            ent->s.number = i;
+        }
+
+        Q_SetBit(sv_frameents, i);
+
+        // beams are checked against PHS, huge entities by headnode
+        if ((ent->s.renderfx & RF_BEAM) || ent->num_clusters == -1)
+            Q_SetBit(sv_extraents, i);
+    }
+
+    // spectators may be watching different channels
+    for (i = 0; sv.state != ss_game && i < count; i++) {
+        if (!i || clients[i]->pool != clients[i - 1]->pool)
+            fix_entity_numbers(clients[i]->pool);
+    }
+
+#if USE_MVD_CLIENT
+    group_client_frames(clients, count);
+#endif
+}
+
+// builds the set of entities touching clusters visible from PVS
+static void build_entity_mask(client_t *client, const byte *pvs, byte *mask)
+{
+    const size_t *src;
+    size_t *dst = (size_t *)mask;
+    const size_t *frame = (const size_t *)sv_frameents;
+    const size_t *extra = (const size_t *)sv_extraents;
+    int i, j, k, longs;
+
+    if (sv.state != ss_game || !sv.clusterents || sv_novis->integer ||
+        client->pool != (edict_pool_t *)&ge->edicts) {
+        memset(mask, 0xff, ENT_MASK_BYTES);
+        return;
+    }
+
+    memset(mask, 0, ENT_MASK_BYTES);
+
+    longs = (sv.numclusters + LONG_BITS - 1) / LONG_BITS;
+    for (i = 0; i < longs; i++) {
+        if (!((const size_t *)pvs)[i])
+            continue;
+        for (j = i * LONG_BITS; j < (i + 1) * LONG_BITS && j < sv.numclusters; j++) {
+            if (!Q_IsBitSet(pvs, j))
+                continue;
+            src = (const size_t *)(sv.clusterents + j * ENT_MASK_BYTES);
+            for (k = 0; k < ENT_MASK_LONGS; k++)
+                dst[k] |= src[k];
+        }
+    }
+
+    for (k = 0; k < ENT_MASK_LONGS; k++)
+        dst[k] = (dst[k] & frame[k]) | extra[k];
+
+    // player's own entity is always sent
+    Q_SetBit(mask, client->number + 1);
+}
+
+/*
+=============
+build_client_frame
 
 Decides which entities are going to be visible to the client, and
-copies off the playerstat and areabits.
+copies off the playerstat and areabits. Entity states are stored in
+svs.entities starting at first_entity. Returns number of states used.
 =============
 */
-void SV_BuildClientFrame(client_t *client)
+static int build_client_frame(client_t *client, unsigned first_entity)
 {
     int         e, i;
     vec3_t      org;
@@ -388,12 +696,14 @@ void SV_BuildClientFrame(client_t *client)
     player_state_t  *ps;
     int         clientarea, clientcluster;
     mleaf_t     *leaf;
-    byte        clientphs[VIS_MAX_BYTES];
     byte        clientpvs[VIS_MAX_BYTES];
+    byte        phsmask[VIS_MAX_BYTES];
+    const byte  *clientphs;
+    byte        entmask[ENT_MASK_BYTES];
 
     clent = client->edict;
     if (!clent->client)
-        return;        // not in game yet
+        return 0;      // not in game yet
 
     // this is the frame we are creating
     frame = &client->frames[client->framenum & UPDATE_MASK];
@@ -403,8 +713,25 @@ void SV_BuildClientFrame(client_t *client)
 
     client->frames_sent++;
 
-    // find the client's PVS
+    // grab the current player_state_t
     ps = &clent->client->ps;
+    MSG_PackPlayer(&frame->ps, ps);
+
+    // grab the current clientNum
+    if (g_features->integer & GMF_CLIENTNUM) {
+        frame->clientNum = clent->client->clientNum;
+    } else {
+        frame->clientNum = client->number;
+    }
+
+#if USE_MVD_CLIENT
+    if (client->framesource) {
+        share_client_frame(client, frame);
+        return 0;
+    }
+#endif
+
+    // find the client's PVS
     VectorMA(ps->viewoffset, 0.125f, ps->pmove.origin, org);
 
     leaf = CM_PointLeaf(client->cm, org);
@@ -418,24 +745,23 @@ void SV_BuildClientFrame(client_t *client)
         frame->areabytes = 1;
     }
 
-    // grab the current player_state_t
-    MSG_PackPlayer(&frame->ps, ps);
-
-    // grab the current clientNum
-    if (g_features->integer & GMF_CLIENTNUM) {
-        frame->clientNum = clent->client->clientNum;
-    } else {
-        frame->clientNum = client->number;
-    }
-
     CM_FatPVS(client->cm, clientpvs, org);
-    BSP_ClusterVis(client->cm->cache, clientphs, clientcluster, DVIS_PHS);
+    clientphs = BSP_GetClusterVis(client->cm->cache, phsmask, clientcluster, DVIS_PHS);
+    build_entity_mask(client, clientpvs, entmask);
 
     // build up the list of visible entities
     frame->num_entities = 0;
-    frame->first_entity = svs.next_entity;
+    frame->first_entity = first_entity;
 
     for (e = 1; e < client->pool->num_edicts; e++) {
+        // skip entities that can't possibly be visible
+        if (!((size_t *)entmask)[e / LONG_BITS]) {
+            e |= LONG_BITS - 1;
+            continue;
+        }
+        if (!Q_IsBitSet(entmask, e))
+            continue;
+
         ent = EDICT_POOL(client, e);
 
         // ignore entities not in use
@@ -503,14 +829,8 @@ void SV_BuildClientFrame(client_t *client)
             }
         }
 
-        if (ent->s.number != e) {
-            Com_WPrintf("%s: fixing ent->s.number: %d to %d\n",
-                        __func__, ent->s.number, e);
-            ent->s.number = e;
-        }
-
         // add it to the circular client_entities array
-        state = &svs.entities[svs.next_entity % svs.num_entities];
+        state = &svs.entities[(first_entity + frame->num_entities) % svs.num_entities];
         MSG_PackEntity(state, &ent->s, Q2PRO_SHORTANGLES(client, e));
 
 #if USE_FPS
@@ -545,10 +865,118 @@ void SV_BuildClientFrame(client_t *client)
             state->solid = sv.entities[e].solid32;
         }
 
-        svs.next_entity++;
-
         if (++frame->num_entities == MAX_PACKET_ENTITIES) {
             break;
         }
     }
+
+    return frame->num_entities;
+}
+
+/*
+=============
+SV_BuildClientFrame
+=============
+*/
+void SV_BuildClientFrame(client_t *client)
+{
+    svs.next_entity += build_client_frame(client, svs.next_entity);
+}
+
+/*
+=============================================================================
+
+Build and encode client frames on worker threads
+
+=============================================================================
+*/
+
+static void write_client_frame(client_t *client)
+{
+    sizebuf_t save = msg_write;
+
+    // redirect writing into private client buffer. overflow is
+    // only flagged here and dealt with on the main thread.
+    msg_write = client->framebuf;
+    msg_write.allowoverflow = true;
+    SZ_Clear(&msg_write);
+
+    client->WriteFrame(client);
+
+    client->framebuf = msg_write;
+    msg_write = save;
+}
+
+static void encode_client_frame(void *arg, int index)
+{
+    client_t *client = ((client_t **)arg)[index];
+    client_frame_t *frame = &client->frames[client->framenum & UPDATE_MASK];
+
+    build_client_frame(client, frame->first_entity);
+    write_client_frame(client);
+}
+
+#if USE_MVD_CLIENT
+// first pass: build frames that other spectators may share
+static void build_source_frame(void *arg, int index)
+{
+    client_t *client = ((client_t **)arg)[index];
+    client_frame_t *frame = &client->frames[client->framenum & UPDATE_MASK];
+
+    if (!client->framesource)
+        build_client_frame(client, frame->first_entity);
+}
+
+// second pass: fill in shared frames and encode everything
+static void encode_shared_frame(void *arg, int index)
+{
+    client_t *client = ((client_t **)arg)[index];
+
+    if (client->framesource)
+        build_client_frame(client, 0);
+    write_client_frame(client);
+}
+#endif
+
+/*
+=============
+SV_EncodeClientFrames
+
+Builds and encodes frames for the given clients in parallel. Each client
+gets a slice of svs.entities reserved in advance, which is safe because the
+ring is sized for MAX_PACKET_ENTITIES per client per frame. Encoded frames
+are kept in client->framebuf until WriteDatagram picks them up. Spectators
+sharing frames need no slice, but are built in a separate pass.
+
+Nothing on the worker path may print or throw: entity numbers are fixed up
+by SV_PrepareClientFrames, debug printing disables threading, and frames
+that overflowed the buffer are encoded again by WriteDatagram.
+=============
+*/
+void SV_EncodeClientFrames(client_t **clients, int count)
+{
+    client_t *client;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        client = clients[i];
+        if (!client->framebuf.data) {
+            SZ_TagInit(&client->framebuf, SV_Malloc(MAX_MSGLEN),
+                       MAX_MSGLEN, SZ_MSG_WRITE);
+        }
+        if (client->framesource)
+            continue;
+        client->frames[client->framenum & UPDATE_MASK].first_entity = svs.next_entity;
+        svs.next_entity += MAX_PACKET_ENTITIES;
+    }
+
+#if USE_MVD_CLIENT
+    if (sv_numsharedframes) {
+        Sys_ParallelFor(sv_threads->integer, count, build_source_frame, clients);
+        Sys_ParallelFor(sv_threads->integer, count, encode_shared_frame, clients);
+        return;
+    }
+#endif
+
+    Sys_ParallelFor(sv_threads->integer, count, encode_client_frame, clients);
 }
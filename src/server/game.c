@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "server.h"
 
 game_export_t    *ge;
+const game_export_ex_t  *ge_ex;
 
 static void PF_configstring(int index, const char *val);
 
@@ -420,6 +421,7 @@ static qboolean PF_inVIS(vec3_t p1, vec3_t p2, int vis)
 {
     mleaf_t *leaf1, *leaf2;
     byte mask[VIS_MAX_BYTES];
+    const byte *row;
     bsp_t *bsp = sv.cm.cache;
 
     if (!bsp) {
@@ -427,12 +429,12 @@ static qboolean PF_inVIS(vec3_t p1, vec3_t p2, int vis)
     }
 
     leaf1 = BSP_PointLeaf(bsp->nodes, p1);
-    BSP_ClusterVis(bsp, mask, leaf1->cluster, vis);
+    row = BSP_GetClusterVis(bsp, mask, leaf1->cluster, vis);
 
     leaf2 = BSP_PointLeaf(bsp->nodes, p2);
     if (leaf2->cluster == -1)
         return false;
-    if (!Q_IsBitSet(mask, leaf2->cluster))
+    if (!Q_IsBitSet(row, leaf2->cluster))
         return false;
     if (!CM_AreasConnected(&sv.cm, leaf1->area, leaf2->area))
         return false;       // a door blocks it
@@ -497,6 +499,7 @@ static void SV_StartSound(vec3_t origin, edict_t *edict, int channel,
     vec3_t      origin_v;
     client_t    *client;
     byte        mask[VIS_MAX_BYTES];
+    const byte  *vis = NULL;
     mleaf_t     *leaf1, *leaf2;
     message_packet_t    *msg;
     bool        force_pos;
@@ -583,7 +586,7 @@ static void SV_StartSound(vec3_t origin, edict_t *edict, int channel,
     leaf1 = NULL;
     if (!(channel & CHAN_NO_PHS_ADD)) {
         leaf1 = CM_PointLeaf(&sv.cm, origin);
-        BSP_ClusterVis(sv.cm.cache, mask, leaf1->cluster, DVIS_PHS);
+        vis = BSP_GetClusterVis(sv.cm.cache, mask, leaf1->cluster, DVIS_PHS);
     }
 
     // decide per client if origin needs to be sent
@@ -595,12 +598,12 @@ static void SV_StartSound(vec3_t origin, edict_t *edict, int channel,
 
         // PHS cull this sound
         if (!(channel & CHAN_NO_PHS_ADD)) {
-            leaf2 = CM_PointLeaf(&sv.cm, client->edict->s.origin);
+            leaf2 = SV_ClientLeaf(client);
             if (!CM_AreasConnected(&sv.cm, leaf1->area, leaf2->area))
                 continue;
             if (leaf2->cluster == -1)
                 continue;
-            if (!Q_IsBitSet(mask, leaf2->cluster))
+            if (!Q_IsBitSet(vis, leaf2->cluster))
                 continue;
         }
 
@@ -738,6 +741,7 @@ void SV_ShutdownGameProgs(void)
         ge->Shutdown();
         ge = NULL;
     }
+    ge_ex = NULL;
     if (game_library) {
         Sys_FreeLibrary(game_library);
         game_library = NULL;
@@ -787,8 +791,10 @@ Init the game subsystem for a new map
 */
 void SV_InitGameProgs(void)
 {
+    static game_import_ex_t import_ex;
     game_import_t   import;
     game_export_t   *(*entry)(game_import_t *) = NULL;
+    game_entry_ex_t entry_ex;
 
     // unload anything we have now
     SV_ShutdownGameProgs();
@@ -880,6 +886,16 @@ void SV_InitGameProgs(void)
                   ge->apiversion, GAME_API_VERSION);
     }
 
+    // extended interface is optional
+    entry_ex = game_library ? Sys_GetProcAddress(game_library, "GetGameAPIEx") : NULL;
+    if (entry_ex) {
+        import_ex.apiversion = GAME_API_VERSION_EX;
+        import_ex.structsize = sizeof(import_ex);
+        import_ex.RadiusEdicts = SV_RadiusEdicts;
+
+        ge_ex = entry_ex(&import_ex);
+    }
+
     // initialize
     ge->Init();
 
@@ -29,6 +29,7 @@ void SV_ClientReset(client_t *client)
 
     // any partially connected client will be restarted
     client->state = cs_connected;
+    client->leaf = NULL;
     client->framenum = 1; // frame 0 can't be used
     client->lastframe = -1;
     client->frames_nodelta = 0;
@@ -160,6 +161,10 @@ void SV_SpawnServer(mapcmd_t *cmd)
     // free current level
     CM_FreeMap(&sv.cm);
     SV_FreeFile(sv.entitystring);
+    Z_Free(sv.clusterents);
+
+    // files may have been updated on disk between levels
+    SV_FlushDownloadCache();
 
     // wipe the entire per-level structure
     memset(&sv, 0, sizeof(sv));
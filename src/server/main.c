@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "server.h"
 #include "client/input.h"
+#include "common/mdfour.h"
 
 pmoveParams_t   sv_pmp;
 
@@ -33,6 +34,15 @@ LIST_DECL(sv_cvarbanlist);
 LIST_DECL(sv_infobanlist);
 LIST_DECL(sv_clientlist);   // linked list of non-free clients
 
+// non-free clients hashed by address and port, clients whose port got
+// translated are found by full scan and rehashed
+#define CLIENT_HASH_SIZE    256
+
+static list_t  sv_clienthash[CLIENT_HASH_SIZE];
+
+#define FOR_EACH_CLIENT_HASH(client, adr) \
+    LIST_FOR_EACH(client_t, client, &sv_clienthash[client_hash(adr)], hashentry)
+
 client_t    *sv_client;         // current client
 edict_t     *sv_player;         // current client edict
 
@@ -59,11 +69,15 @@ cvar_t  *sv_show_name_changes;
 cvar_t  *sv_airaccelerate;
 cvar_t  *sv_qwmod;              // atu QW Physics modificator
 cvar_t  *sv_novis;
+cvar_t  *sv_area_tree;
+cvar_t  *sv_threads;
 
 cvar_t  *sv_maxclients;
 cvar_t  *sv_reserved_slots;
 cvar_t  *sv_locked;
 cvar_t  *sv_downloadserver;
+cvar_t  *sv_download_cache;
+cvar_t  *sv_multicast_batch;
 cvar_t  *sv_redirect_address;
 
 cvar_t  *sv_hostname;
@@ -110,6 +124,28 @@ static bool     sv_registered;
 
 //============================================================================
 
+static unsigned client_hash(const netadr_t *adr)
+{
+    uint32_t h;
+
+    switch (adr->type) {
+    case NA_IP:
+    case NA_BROADCAST:
+        h = adr->ip.u32[0];
+        break;
+    case NA_IP6:
+        h = adr->ip.u32[0] ^ adr->ip.u32[1] ^ adr->ip.u32[2] ^ adr->ip.u32[3];
+        break;
+    default:
+        return 0;
+    }
+
+    h ^= adr->port;
+    h ^= h >> 16;
+    h ^= h >> 8;
+    return h & (CLIENT_HASH_SIZE - 1);
+}
+
 void SV_RemoveClient(client_t *client)
 {
     if (client->msg_pool) {
@@ -125,6 +161,9 @@ void SV_RemoveClient(client_t *client)
     // itself to make code that traverses client list in a loop happy!
     List_Remove(&client->entry);
 
+    // unlink them from address hash
+    List_Delete(&client->hashentry);
+
 #if USE_MVD_CLIENT
     // unlink them from MVD client list
     if (sv.state == ss_broadcast) {
@@ -562,6 +601,97 @@ static void SVC_Ping(void)
     OOB_PRINT(NS_SERVER, &net_from, "ack");
 }
 
+/*
+Challenges are keyed hashes of the client base address, so that they can be
+verified without keeping any per-address state that could be flooded. The key
+is rotated every CHALLENGE_EPOCH milliseconds, and challenges made with the
+previous key are still accepted, giving each challenge 1-2 epochs of life.
+*/
+
+#define CHALLENGE_EPOCH     30000
+
+static struct {
+    unsigned    epoch;
+    uint8_t     keys[2][16];    // current and previous
+} sv_challenge;
+
+static void make_challenge_key(uint8_t *key)
+{
+    struct mdfour md;
+    uint32_t seed[6];
+    int i;
+
+    // mix previous key with whatever entropy we have
+    for (i = 0; i < 4; i++) {
+        seed[i] = Q_rand();
+    }
+    seed[4] = Sys_Milliseconds();
+    seed[5] = com_eventTime;
+
+    mdfour_begin(&md);
+    mdfour_update(&md, sv_challenge.keys[0], sizeof(sv_challenge.keys[0]));
+    mdfour_update(&md, (uint8_t *)seed, sizeof(seed));
+    mdfour_result(&md, key);
+}
+
+static void init_challenge_keys(void)
+{
+    make_challenge_key(sv_challenge.keys[1]);
+    make_challenge_key(sv_challenge.keys[0]);
+    sv_challenge.epoch = com_eventTime / CHALLENGE_EPOCH;
+}
+
+static void update_challenge_keys(void)
+{
+    unsigned epoch = com_eventTime / CHALLENGE_EPOCH;
+
+    if (epoch == sv_challenge.epoch) {
+        return;
+    }
+
+    if (epoch == sv_challenge.epoch + 1) {
+        memcpy(sv_challenge.keys[1], sv_challenge.keys[0], sizeof(sv_challenge.keys[0]));
+    } else {
+        make_challenge_key(sv_challenge.keys[1]);
+    }
+    make_challenge_key(sv_challenge.keys[0]);
+
+    sv_challenge.epoch = epoch;
+}
+
+static int make_challenge(const netadr_t *adr, const uint8_t *key)
+{
+    struct mdfour md;
+    uint8_t digest[16];
+    uint32_t challenge;
+
+    mdfour_begin(&md);
+    mdfour_update(&md, key, 16);
+    switch (adr->type) {
+    case NA_IP:
+    case NA_BROADCAST:
+        mdfour_update(&md, adr->ip.u8, 4);
+        break;
+    case NA_IP6:
+        mdfour_update(&md, adr->ip.u8, 16);
+        break;
+    default:
+        break;
+    }
+    mdfour_result(&md, digest);
+
+    challenge = LittleLongMem(digest) & 0x7fffffff;
+    return challenge ? challenge : 1;
+}
+
+static bool check_challenge(const netadr_t *adr, int challenge)
+{
+    update_challenge_keys();
+
+    return challenge == make_challenge(adr, sv_challenge.keys[0]) ||
+           challenge == make_challenge(adr, sv_challenge.keys[1]);
+}
+
 /*
 =================
 SVC_GetChallenge
@@ -575,36 +705,11 @@ challenge, they must give a valid IP address.
 */
 static void SVC_GetChallenge(void)
 {
-    int         i, oldest;
-    unsigned    challenge;
-    unsigned    oldestTime;
+    int challenge;
 
-    oldest = 0;
-    oldestTime = 0xffffffff;
+    update_challenge_keys();
 
-    // see if we already have a challenge for this ip
-    for (i = 0; i < MAX_CHALLENGES; i++) {
-        if (NET_IsEqualBaseAdr(&net_from, &svs.challenges[i].adr))
-            break;
-        if (svs.challenges[i].time > com_eventTime) {
-            svs.challenges[i].time = com_eventTime;
-        }
-        if (svs.challenges[i].time < oldestTime) {
-            oldestTime = svs.challenges[i].time;
-            oldest = i;
-        }
-    }
-
-    challenge = Q_rand() & 0x7fffffff;
-    if (i == MAX_CHALLENGES) {
-        // overwrite the oldest
-        svs.challenges[oldest].challenge = challenge;
-        svs.challenges[oldest].adr = net_from;
-        svs.challenges[oldest].time = com_eventTime;
-    } else {
-        svs.challenges[i].challenge = challenge;
-        svs.challenges[i].time = com_eventTime;
-    }
+    challenge = make_challenge(&net_from, sv_challenge.keys[0]);
 
     // send it back
     Netchan_OutOfBand(NS_SERVER, &net_from,
@@ -662,7 +767,7 @@ static bool parse_basic_params(conn_params_t *p)
 static bool permit_connection(conn_params_t *p)
 {
     addrmatch_t *match;
-    int i, count;
+    int count;
     client_t *cl;
     char *s;
 
@@ -671,22 +776,8 @@ static bool permit_connection(conn_params_t *p)
         return true;
 
     // see if the challenge is valid
-    for (i = 0; i < MAX_CHALLENGES; i++) {
-        if (!svs.challenges[i].challenge)
-            continue;
-
-        if (NET_IsEqualBaseAdr(&net_from, &svs.challenges[i].adr)) {
-            if (svs.challenges[i].challenge == p->challenge)
-                break;        // good
-
-            return reject("Bad challenge.\n");
-        }
-    }
-
-    if (i == MAX_CHALLENGES)
-        return reject("No challenge for address.\n");
-
-    svs.challenges[i].challenge = 0;
+    if (!check_challenge(&net_from, p->challenge))
+        return reject("Bad challenge.\n");
 
     // check for banned address
     if ((match = SV_MatchAddress(&sv_banlist, &net_from)) != NULL) {
@@ -930,7 +1021,7 @@ static client_t *find_client_slot(conn_params_t *params)
     int i;
 
     // if there is already a slot for this ip, reuse it
-    FOR_EACH_CLIENT(cl) {
+    FOR_EACH_CLIENT_HASH(cl, &net_from) {
         if (NET_IsEqualAdr(&net_from, &cl->netchan->remote_address)) {
             if (cl->state == cs_zombie) {
                 strcpy(params->reconnect_var, cl->reconnect_var);
@@ -1164,6 +1255,7 @@ static void SVC_DirectConnect(void)
 
     // add them to the linked list of connected clients
     List_SeqAdd(&sv_clientlist, &newcl->entry);
+    List_Append(&sv_clienthash[client_hash(&net_from)], &newcl->hashentry);
 
     Com_DPrintf("Going from cs_free to cs_assigned for %s\n", newcl->name);
     newcl->state = cs_assigned;
@@ -1478,6 +1570,49 @@ static void SV_GiveMsec(void)
 }
 
 
+static bool is_packet_from(client_t *client)
+{
+    netchan_t   *netchan = client->netchan;
+    int         qport;
+
+    if (!NET_IsEqualBaseAdr(&net_from, &netchan->remote_address)) {
+        return false;
+    }
+
+    // read the qport out of the message so we can fix up
+    // stupid address translating routers
+    if (client->protocol == PROTOCOL_VERSION_DEFAULT) {
+        qport = msg_read.data[8] | (msg_read.data[9] << 8);
+        return netchan->qport == qport;
+    }
+
+    if (netchan->qport) {
+        qport = msg_read.data[8];
+        return netchan->qport == qport;
+    }
+
+    return netchan->remote_address.port == net_from.port;
+}
+
+static client_t *find_packet_client(void)
+{
+    client_t    *client;
+
+    FOR_EACH_CLIENT_HASH(client, &net_from) {
+        if (is_packet_from(client)) {
+            return client;
+        }
+    }
+
+    FOR_EACH_CLIENT(client) {
+        if (is_packet_from(client)) {
+            return client;
+        }
+    }
+
+    return NULL;
+}
+
 /*
 =================
 SV_PacketEvent
@@ -1487,7 +1622,6 @@ static void SV_PacketEvent(void)
 {
     client_t    *client;
     netchan_t   *netchan;
-    int         qport;
 
     // check for connectionless packet (0xffffffff) first
     // connectionless packets are processed even if the server is down
@@ -1500,54 +1634,37 @@ static void SV_PacketEvent(void)
         return;
     }
 
-    // check for packets from connected clients
-    FOR_EACH_CLIENT(client) {
-        netchan = client->netchan;
-        if (!NET_IsEqualBaseAdr(&net_from, &netchan->remote_address)) {
-            continue;
-        }
-
-        // read the qport out of the message so we can fix up
-        // stupid address translating routers
-        if (client->protocol == PROTOCOL_VERSION_DEFAULT) {
-            qport = msg_read.data[8] | (msg_read.data[9] << 8);
-            if (netchan->qport != qport) {
-                continue;
-            }
-        } else if (netchan->qport) {
-            qport = msg_read.data[8];
-            if (netchan->qport != qport) {
-                continue;
-            }
-        } else {
-            if (netchan->remote_address.port != net_from.port) {
-                continue;
-            }
-        }
+    // check for packets from connected clients, port may have been
+    // changed by address translating router, so check them all
+    client = find_packet_client();
+    if (!client) {
+        return;
+    }
 
-        if (netchan->remote_address.port != net_from.port) {
-            Com_DPrintf("Fixing up a translated port for %s: %d --> %d\n",
-                        client->name, netchan->remote_address.port, net_from.port);
-            netchan->remote_address.port = net_from.port;
-        }
+    netchan = client->netchan;
+    if (netchan->remote_address.port != net_from.port) {
+        Com_DPrintf("Fixing up a translated port for %s: %d --> %d\n",
+                    client->name, netchan->remote_address.port, net_from.port);
+        netchan->remote_address.port = net_from.port;
+        List_Remove(&client->hashentry);
+        List_Append(&sv_clienthash[client_hash(&net_from)], &client->hashentry);
+    }
 
-        if (!netchan->Process(netchan))
-            break;
+    if (!netchan->Process(netchan))
+        return;
 
-        if (client->state == cs_zombie)
-            break;
+    if (client->state == cs_zombie)
+        return;
 
-        // this is a valid, sequenced packet, so process it
-        client->lastmessage = svs.realtime;    // don't timeout
+    // this is a valid, sequenced packet, so process it
+    client->lastmessage = svs.realtime;    // don't timeout
 #if USE_ICMP
-        client->unreachable = false; // don't drop
+    client->unreachable = false; // don't drop
 #endif
-        if (netchan->dropped > 0)
-            client->frameflags |= FF_CLIENTDROP;
+    if (netchan->dropped > 0)
+        client->frameflags |= FF_CLIENTDROP;
 
-        SV_ExecuteClientMessage(client);
-        break;
-    }
+    SV_ExecuteClientMessage(client);
 }
 
 #if USE_PMTUDISC
@@ -1589,36 +1706,51 @@ static void update_client_mtu(client_t *client, int ee_info)
 SV_ErrorEvent
 =================
 */
+// returns true if no more clients need to be checked
+static bool client_error(client_t *client, const netadr_t *from, int ee_errno, int ee_info)
+{
+    netchan_t   *netchan = client->netchan;
+
+    if (client->state == cs_zombie) {
+        return false; // already a zombie
+    }
+    if (!NET_IsEqualBaseAdr(from, &netchan->remote_address)) {
+        return false;
+    }
+    if (from->port && netchan->remote_address.port != from->port) {
+        return false;
+    }
+#if USE_PMTUDISC
+    // for EMSGSIZE ee_info should hold discovered MTU
+    if (ee_errno == EMSGSIZE) {
+        update_client_mtu(client, ee_info);
+        return false;
+    }
+#endif
+    client->unreachable = true; // drop them soon
+    return true;
+}
+
 void SV_ErrorEvent(netadr_t *from, int ee_errno, int ee_info)
 {
     client_t    *client;
-    netchan_t   *netchan;
 
     if (!svs.initialized) {
         return;
     }
 
-    // check for errors from connected clients
-    FOR_EACH_CLIENT(client) {
-        if (client->state == cs_zombie) {
-            continue; // already a zombie
+    // check for errors from connected clients, without
+    // port to hash on check all of them
+    if (from->port) {
+        FOR_EACH_CLIENT_HASH(client, from) {
+            if (client_error(client, from, ee_errno, ee_info))
+                break;
         }
-        netchan = client->netchan;
-        if (!NET_IsEqualBaseAdr(from, &netchan->remote_address)) {
-            continue;
-        }
-        if (from->port && netchan->remote_address.port != from->port) {
-            continue;
-        }
-#if USE_PMTUDISC
-        // for EMSGSIZE ee_info should hold discovered MTU
-        if (ee_errno == EMSGSIZE) {
-            update_client_mtu(client, ee_info);
-            continue;
+    } else {
+        FOR_EACH_CLIENT(client) {
+            if (client_error(client, from, ee_errno, ee_info))
+                break;
         }
-#endif
-        client->unreachable = true; // drop them soon
-        break;
     }
 }
 #endif
@@ -1760,15 +1892,23 @@ SV_RunGameFrame
 */
 static void SV_RunGameFrame(void)
 {
+    uint64_t start;
+
     // save the entire world state if recording a serverdemo
+    start = SV_ProfileStart();
     SV_MvdBeginFrame();
+    SV_ProfileEnd(PROF_MVD, start);
 
 #if USE_CLIENT
     if (host_speeds->integer)
         time_before_game = Sys_Milliseconds();
 #endif
 
+    start = SV_ProfileStart();
+    SV_BeginMulticasts();
     ge->RunFrame();
+    SV_FlushMulticasts();
+    SV_ProfileEnd(PROF_GAME, start);
 
 #if USE_CLIENT
     if (host_speeds->integer)
@@ -1783,7 +1923,9 @@ static void SV_RunGameFrame(void)
     }
 
     // save the entire world state if recording a serverdemo
+    start = SV_ProfileStart();
     SV_MvdEndFrame();
+    SV_ProfileEnd(PROF_MVD, start);
 }
 
 /*
@@ -1872,7 +2014,7 @@ static void SV_MasterShutdown(void)
 
 /*
 ==================
-SV_Frame
+SV_RunFrame
 
 Some things like MVD client connections and command buffer
 processing are run even when server is not yet initalized.
@@ -1880,8 +2022,10 @@ processing are run even when server is not yet initalized.
 Returns amount of extra frametime available for sleeping on IO.
 ==================
 */
-unsigned SV_Frame(unsigned msec)
+static unsigned SV_RunFrame(unsigned msec)
 {
+    uint64_t start;
+
 #if USE_CLIENT
     time_before_game = time_after_game = 0;
 #endif
@@ -1900,7 +2044,9 @@ unsigned SV_Frame(unsigned msec)
 #endif
 
     // read packets from UDP clients
+    start = SV_ProfileStart();
     NET_GetPackets(NS_SERVER, SV_PacketEvent);
+    SV_ProfileEnd(PROF_PACKETS, start);
 
     if (svs.initialized) {
         // run connection to the anticheat server
@@ -1910,7 +2056,9 @@ unsigned SV_Frame(unsigned msec)
         SV_MvdRunClients();
 
         // deliver fragments and reliable messages for connecting clients
+        start = SV_ProfileStart();
         SV_SendAsyncPackets();
+        SV_ProfileEnd(PROF_ASYNC, start);
     }
 
     // move autonomous things around if enough time has passed
@@ -1967,6 +2115,28 @@ unsigned SV_Frame(unsigned msec)
     return 0;
 }
 
+/*
+==================
+SV_Frame
+
+Runs the server frame, accounting time spent in it to the profiler.
+==================
+*/
+unsigned SV_Frame(unsigned msec)
+{
+    uint64_t start = SV_ProfileStart();
+    int framenum = sv.framenum;
+    unsigned ret = SV_RunFrame(msec);
+
+    SV_ProfileEnd(PROF_FRAME, start);
+
+    // account everything done since the last tick to this one
+    if (sv.framenum != framenum)
+        SV_ProfileFrame();
+
+    return ret;
+}
+
 //============================================================================
 
 /*
@@ -2128,6 +2298,16 @@ Only called at quake2.exe startup, not for each game
 */
 void SV_Init(void)
 {
+    int i;
+
+    for (i = 0; i < CLIENT_HASH_SIZE; i++) {
+        List_Init(&sv_clienthash[i]);
+    }
+
+    init_challenge_keys();
+
+    SV_InitDownloadCache();
+
     SV_InitOperatorCommands();
 
     SV_MvdRegister();
@@ -2140,6 +2320,8 @@ void SV_Init(void)
 
     SV_RegisterSavegames();
 
+    SV_RegisterProfile();
+
     Cvar_Get("protocol", STRINGIFY(PROTOCOL_VERSION_DEFAULT), CVAR_SERVERINFO | CVAR_ROM);
 
     Cvar_Get("skill", "1", CVAR_LATCH);
@@ -2188,7 +2370,11 @@ void SV_Init(void)
     sv_reserved_password = Cvar_Get("sv_reserved_password", "", CVAR_PRIVATE);
     sv_locked = Cvar_Get("sv_locked", "0", 0);
     sv_novis = Cvar_Get("sv_novis", "0", 0);
+    sv_area_tree = Cvar_Get("sv_area_tree", "1", CVAR_LATCH);
+    sv_threads = Cvar_Get("sv_threads", "0", 0);
     sv_downloadserver = Cvar_Get("sv_downloadserver", "", 0);
+    sv_download_cache = Cvar_Get("sv_download_cache", "64", 0);
+    sv_multicast_batch = Cvar_Get("sv_multicast_batch", "0", 0);
     sv_redirect_address = Cvar_Get("sv_redirect_address", "", 0);
 
 #ifdef _DEBUG
@@ -2335,6 +2521,9 @@ void SV_Shutdown(const char *finalmsg, error_type_t type)
     if (!sv_registered)
         return;
 
+    // error may have been thrown while batching packets
+    NET_FlushBatch(NS_SERVER);
+
 #if USE_MVD_CLIENT
     if (ge != &mvd_ge && !(type & MVD_SPAWN_INTERNAL)) {
         // shutdown MVD client now if not already running the built-in MVD game module
@@ -2355,10 +2544,12 @@ void SV_Shutdown(const char *finalmsg, error_type_t type)
     // free current level
     CM_FreeMap(&sv.cm);
     SV_FreeFile(sv.entitystring);
+    Z_Free(sv.clusterents);
     memset(&sv, 0, sizeof(sv));
 
     // free server static data
     Z_Free(svs.client_pool);
+    SV_FlushDownloadCache();
     Z_Free(svs.entities);
 #if USE_ZLIB
     deflateEnd(&svs.z);
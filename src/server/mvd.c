@@ -43,6 +43,9 @@ typedef struct {
     unsigned    flags;
     unsigned    maxbuf;
     unsigned    bufcount;
+#if USE_ZLIB
+    bool        shared;     // receiving shared deflate stream
+#endif
 
     byte        buffer[MAX_GTC_MSGLEN + 4]; // recv buffer
     byte        *data; // send buffer
@@ -76,6 +79,14 @@ typedef struct {
 
     // TCP client pool
     gtv_client_t    *clients; // [sv_mvd_maxclients]
+
+#if USE_ZLIB
+    // shared deflate stream, compressed once for all active clients
+    z_stream        z;
+    unsigned        numshared;
+    bool            zpending;   // input since last flush
+    bool            zhistory;   // input since last full flush
+#endif
 } mvd_server_t;
 
 static mvd_server_t     mvd;
@@ -113,8 +124,14 @@ static void     mvd_error(const char *reason);
 static void     write_stream(gtv_client_t *client, void *data, size_t len);
 static void     write_message(gtv_client_t *client, gtv_serverop_t op);
 #if USE_ZLIB
-static void     flush_stream(gtv_client_t *client, int flush);
+static bool     flush_stream(gtv_client_t *client, int flush);
+static void     shared_deflate(void *data, size_t len, int flush);
+static void     join_shared_stream(void);
+static void     leave_shared_stream(gtv_client_t *client);
 #endif
+static void     broadcast_stream(void *data, size_t len);
+static void     broadcast_message(gtv_serverop_t op);
+static void     broadcast_flush(void);
 
 static void     rec_stop(void);
 static bool     rec_allowed(void);
@@ -378,6 +395,7 @@ static int dummy_create(void)
     newcl->netchan->remote_address.type = NA_LOOPBACK;
 
     List_Init(&newcl->entry);
+    List_Init(&newcl->hashentry);
 
     if (g_features->integer & GMF_EXTRA_USERINFO) {
         strcpy(userinfo, MVD_USERINFO1);
@@ -820,12 +838,11 @@ static void suspend_streams(void)
 {
     gtv_client_t *client;
 
+    // send stream suspend marker
+    broadcast_message(GTS_STREAM_DATA);
+    broadcast_flush();
+
     FOR_EACH_ACTIVE_GTV(client) {
-        // send stream suspend marker
-        write_message(client, GTS_STREAM_DATA);
-#if USE_ZLIB
-        flush_stream(client, Z_SYNC_FLUSH);
-#endif
         NET_UpdateStream(&client->stream);
     }
 
@@ -841,12 +858,11 @@ static void resume_streams(void)
     build_gamestate();
     emit_gamestate();
 
+    // send gamestate
+    broadcast_message(GTS_STREAM_DATA);
+    broadcast_flush();
+
     FOR_EACH_ACTIVE_GTV(client) {
-        // send gamestate
-        write_message(client, GTS_STREAM_DATA);
-#if USE_ZLIB
-        flush_stream(client, Z_SYNC_FLUSH);
-#endif
         NET_UpdateStream(&client->stream);
     }
 
@@ -1019,6 +1035,9 @@ void SV_MvdEndFrame(void)
     gtv_client_t *client;
     size_t total;
     byte header[3];
+#if USE_ZLIB
+    bool flush;
+#endif
 
     if (!SV_FRAMESYNC)
         return;
@@ -1068,17 +1087,35 @@ void SV_MvdEndFrame(void)
     header[1] = (total >> 8) & 255;
     header[2] = GTS_STREAM_DATA;
 
+#if USE_ZLIB
+    // let compressing clients switch to shared stream at frame boundary
+    join_shared_stream();
+#endif
+
     // send frame to clients
-    FOR_EACH_ACTIVE_GTV(client) {
-        write_stream(client, header, sizeof(header));
-        write_stream(client, mvd.message.data, mvd.message.cursize);
-        write_stream(client, msg_write.data, msg_write.cursize);
-        write_stream(client, mvd.datagram.data, mvd.datagram.cursize);
+    broadcast_stream(header, sizeof(header));
+    broadcast_stream(mvd.message.data, mvd.message.cursize);
+    broadcast_stream(msg_write.data, msg_write.cursize);
+    broadcast_stream(mvd.datagram.data, mvd.datagram.cursize);
+
 #if USE_ZLIB
+    // shared stream is flushed as soon as any of its clients needs it
+    flush = false;
+    FOR_EACH_ACTIVE_GTV(client) {
         if (++client->bufcount > client->maxbuf) {
-            flush_stream(client, Z_SYNC_FLUSH);
+            if (client->shared) {
+                flush = true;
+            } else {
+                flush_stream(client, Z_SYNC_FLUSH);
+            }
         }
+    }
+    if (flush) {
+        shared_deflate(NULL, 0, Z_SYNC_FLUSH);
+    }
 #endif
+
+    FOR_EACH_ACTIVE_GTV(client) {
         NET_UpdateStream(&client->stream);
     }
 
@@ -1305,7 +1342,8 @@ static void remove_client(gtv_client_t *client)
 }
 
 #if USE_ZLIB
-static void flush_stream(gtv_client_t *client, int flush)
+// returns false if flush couldn't be completed because send buffer is full
+static bool flush_stream(gtv_client_t *client, int flush)
 {
     fifo_t *fifo = &client->stream.send;
     z_streamp z = &client->z;
@@ -1314,12 +1352,15 @@ static void flush_stream(gtv_client_t *client, int flush)
     int ret;
 
     if (client->state <= cs_zombie) {
-        return;
+        return false;
     }
     if (!z->state) {
-        return;
+        return false;
     }
 
+    // private stream can only continue at shared stream block boundary
+    leave_shared_stream(client);
+
     z->next_in = NULL;
     z->avail_in = 0;
 
@@ -1327,7 +1368,7 @@ static void flush_stream(gtv_client_t *client, int flush)
         data = FIFO_Reserve(fifo, &len);
         if (!len) {
             // FIXME: this is not an error when flushing
-            return;
+            return false;
         }
 
         z->next_out = data;
@@ -1341,6 +1382,8 @@ static void flush_stream(gtv_client_t *client, int flush)
             client->bufcount = 0;
         }
     } while (ret == Z_OK);
+
+    return true;
 }
 #endif
 
@@ -1386,6 +1429,9 @@ static void write_stream(gtv_client_t *client, void *data, size_t len)
     if (client->z.state) {
         z_streamp z = &client->z;
 
+        // private data can only follow at shared stream block boundary
+        leave_shared_stream(client);
+
         z->next_in = data;
         z->avail_in = (uInt)len;
 
@@ -1431,6 +1477,215 @@ static void write_message(gtv_client_t *client, gtv_serverop_t op)
     write_stream(client, msg_write.data, msg_write.cursize);
 }
 
+#if USE_ZLIB
+
+/*
+Data broadcast to all active clients is compressed only once by the shared
+raw deflate stream and the compressed bytes are copied into send buffer of
+each client that is attached to it. This works because:
+
+- clients are attached only at a point where both their private stream and
+shared stream have been fully flushed, so neither stream references data the
+other one has produced;
+
+- clients are detached only after shared stream has been sync flushed, so any
+private data that follows starts at a block boundary;
+
+- Adler-32 checksum of the uncompressed shared data is merged into private
+stream checksum, so that zlib trailer remains valid when stream is finished.
+*/
+
+static void shared_deflate(void *data, size_t len, int flush)
+{
+    static byte buffer[MAX_GTS_MSGLEN];
+    z_streamp z = &mvd.z;
+    gtv_client_t *client;
+    uLong adler;
+    size_t outlen;
+
+    if (!mvd.numshared) {
+        return;
+    }
+
+    if (len) {
+        adler = adler32(1, data, len);
+        FOR_EACH_ACTIVE_GTV(client) {
+            if (client->shared) {
+                client->z.adler = adler32_combine(client->z.adler, adler, len);
+            }
+        }
+        mvd.zpending = mvd.zhistory = true;
+    } else if (flush == Z_FULL_FLUSH) {
+        if (!mvd.zhistory) {
+            return;
+        }
+    } else if (!mvd.zpending) {
+        return;
+    }
+
+    z->next_in = data;
+    z->avail_in = (uInt)len;
+
+    do {
+        z->next_out = buffer;
+        z->avail_out = sizeof(buffer);
+
+        if (deflate(z, flush) == Z_STREAM_ERROR) {
+            FOR_EACH_ACTIVE_GTV(client) {
+                if (client->shared) {
+                    client->shared = false;
+                    drop_client(client, "deflate() failed");
+                }
+            }
+            mvd.numshared = 0;
+            return;
+        }
+
+        outlen = sizeof(buffer) - z->avail_out;
+        if (!outlen) {
+            continue;
+        }
+
+        FOR_EACH_ACTIVE_GTV(client) {
+            if (!client->shared) {
+                continue;
+            }
+            if (FIFO_Write(&client->stream.send, buffer, outlen) != outlen) {
+                client->shared = false;
+                mvd.numshared--;
+                drop_client(client, "overflowed");
+                continue;
+            }
+            client->bufcount = 0;
+        }
+    } while (z->avail_in || !z->avail_out);
+
+    if (flush != Z_NO_FLUSH) {
+        mvd.zpending = false;
+    }
+    if (flush == Z_FULL_FLUSH) {
+        mvd.zhistory = false;
+    }
+}
+
+static bool can_join_shared_stream(gtv_client_t *client)
+{
+    return client->state == cs_spawned && client->z.state && !client->shared;
+}
+
+static void join_shared_stream(void)
+{
+    gtv_client_t *client;
+
+    FOR_EACH_ACTIVE_GTV(client) {
+        if (can_join_shared_stream(client)) {
+            break;
+        }
+    }
+
+    if (LIST_TERM(client, &gtv_active_list, active)) {
+        return;
+    }
+
+    if (!mvd.z.state) {
+        mvd.z.zalloc = SV_zalloc;
+        mvd.z.zfree = SV_zfree;
+        if (deflateInit2(&mvd.z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                         -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            Com_EPrintf("%s: deflateInit2() failed\n", __func__);
+            return;
+        }
+    }
+
+    if (mvd.numshared) {
+        // drop history so that new clients can decode from this point
+        shared_deflate(NULL, 0, Z_FULL_FLUSH);
+    } else {
+        deflateReset(&mvd.z);
+        mvd.zpending = mvd.zhistory = false;
+    }
+
+    FOR_EACH_ACTIVE_GTV(client) {
+        if (!can_join_shared_stream(client)) {
+            continue;
+        }
+        // try again next frame if send buffer is full
+        if (!flush_stream(client, Z_FULL_FLUSH)) {
+            continue;
+        }
+        client->shared = true;
+        mvd.numshared++;
+    }
+}
+
+static void leave_shared_stream(gtv_client_t *client)
+{
+    if (!client->shared) {
+        return;
+    }
+
+    // this may also drop the client on overflow
+    shared_deflate(NULL, 0, Z_SYNC_FLUSH);
+
+    if (client->shared) {
+        client->shared = false;
+        mvd.numshared--;
+    }
+}
+
+#endif // USE_ZLIB
+
+// writes data to all active clients
+static void broadcast_stream(void *data, size_t len)
+{
+    gtv_client_t *client;
+
+    if (!len) {
+        return;
+    }
+
+#if USE_ZLIB
+    shared_deflate(data, len, Z_NO_FLUSH);
+#endif
+
+    FOR_EACH_ACTIVE_GTV(client) {
+#if USE_ZLIB
+        if (client->shared) {
+            continue;
+        }
+#endif
+        write_stream(client, data, len);
+    }
+}
+
+static void broadcast_message(gtv_serverop_t op)
+{
+    byte header[3];
+    size_t len = msg_write.cursize + 1;
+
+    header[0] = len & 255;
+    header[1] = (len >> 8) & 255;
+    header[2] = op;
+    broadcast_stream(header, sizeof(header));
+
+    broadcast_stream(msg_write.data, msg_write.cursize);
+}
+
+static void broadcast_flush(void)
+{
+#if USE_ZLIB
+    gtv_client_t *client;
+
+    shared_deflate(NULL, 0, Z_SYNC_FLUSH);
+
+    FOR_EACH_ACTIVE_GTV(client) {
+        if (!client->shared) {
+            flush_stream(client, Z_SYNC_FLUSH);
+        }
+    }
+#endif
+}
+
 static bool auth_client(gtv_client_t *client, const char *password)
 {
     if (SV_MatchAddress(&gtv_white_list, &client->stream.address))
@@ -1590,6 +1845,10 @@ static void parse_stream_stop(gtv_client_t *client)
 
     client->state = cs_primed;
 
+#if USE_ZLIB
+    leave_shared_stream(client);
+#endif
+
     List_Delete(&client->active);
 
     // send ack to client
@@ -2007,8 +2266,8 @@ void SV_MvdMapChanged(void)
         emit_gamestate();
 
         // send gamestate to all MVD clients
+        broadcast_message(GTS_STREAM_DATA);
         FOR_EACH_ACTIVE_GTV(client) {
-            write_message(client, GTS_STREAM_DATA);
             NET_UpdateStream(&client->stream);
         }
     }
@@ -2126,6 +2385,12 @@ void SV_MvdShutdown(error_type_t type)
     Z_Free(mvd.message.data);
     Z_Free(mvd.clients);
 
+#if USE_ZLIB
+    if (mvd.z.state) {
+        deflateEnd(&mvd.z);
+    }
+#endif
+
     // close server TCP socket
     NET_Listen(false);
 
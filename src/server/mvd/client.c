@@ -78,6 +78,7 @@ typedef struct gtv_s {
     string_entry_t  *demohead, *demoentry;
     int64_t         demosize, demopos;
     bool            demowait;
+    bool            demofirstmap;   // index can only be built for first map
 } gtv_t;
 
 static const char *const gtv_states[GTV_NUM_STATES] = {
@@ -136,15 +137,25 @@ void MVD_StopRecord(mvd_t *mvd)
     mvd->demoname = NULL;
 }
 
-static void MVD_Free(mvd_t *mvd)
+void MVD_FreeSnapshots(mvd_t *mvd)
 {
-    mvd_snap_t *snap, *next;
     int i;
 
-    LIST_FOR_EACH_SAFE(mvd_snap_t, snap, next, &mvd->snapshots, entry) {
-        Z_Free(snap);
+    for (i = 0; i < mvd->numsnapshots; i++) {
+        Z_Free(mvd->snapshots[i]);
     }
 
+    Z_Free(mvd->snapshots);
+    mvd->snapshots = NULL;
+    mvd->numsnapshots = 0;
+}
+
+static void MVD_Free(mvd_t *mvd)
+{
+    int i;
+
+    MVD_FreeSnapshots(mvd);
+
     // stop demo recording
     if (mvd->demorecording) {
         MVD_StopRecord(mvd);
@@ -328,7 +339,6 @@ static mvd_t *create_channel(gtv_t *gtv)
     mvd->pool.max_edicts = MAX_EDICTS;
     mvd->pm_type = PM_SPECTATOR;
     mvd->min_packets = mvd_wait_delay->integer;
-    List_Init(&mvd->snapshots);
     List_Init(&mvd->clients);
     List_Init(&mvd->entry);
 
@@ -544,6 +554,24 @@ static int demo_read_first(qhandle_t f)
     return read ? read : Q_ERR_UNEXPECTED_EOF;
 }
 
+#define SNAP_GROW   64
+
+// snapshots are always added in increasing framenum order
+static void demo_add_snapshot(mvd_t *mvd, mvd_snap_t *snap)
+{
+    size_t size;
+
+    if (!(mvd->numsnapshots % SNAP_GROW)) {
+        size = sizeof(mvd->snapshots[0]) * (mvd->numsnapshots + SNAP_GROW);
+        if (mvd->snapshots)
+            mvd->snapshots = Z_Realloc(mvd->snapshots, size);
+        else
+            mvd->snapshots = MVD_Malloc(size);
+    }
+
+    mvd->snapshots[mvd->numsnapshots++] = snap;
+}
+
 // periodically builds a fake demo packet used to reconstruct delta compression
 // state, configstrings and layouts at the given server frame.
 static void demo_emit_snapshot(mvd_t *mvd)
@@ -601,7 +629,7 @@ static void demo_emit_snapshot(mvd_t *mvd)
     snap->filepos = pos;
     snap->msglen = msg_write.cursize;
     memcpy(snap->data, msg_write.data, msg_write.cursize);
-    List_Append(&mvd->snapshots, &snap->entry);
+    demo_add_snapshot(mvd, snap);
 
     Com_DPrintf("[%d] snaplen %zu\n", mvd->framenum, msg_write.cursize);
 
@@ -610,22 +638,223 @@ static void demo_emit_snapshot(mvd_t *mvd)
     mvd->last_snapshot = mvd->framenum;
 }
 
+// returns the most recent snapshot not newer than the given frame, or the
+// first snapshot if there is no such one
 static mvd_snap_t *demo_find_snapshot(mvd_t *mvd, int framenum)
 {
-    mvd_snap_t *snap, *prev;
+    int lo, hi, mid;
 
-    if (LIST_EMPTY(&mvd->snapshots))
+    if (!mvd->numsnapshots)
         return NULL;
 
-    prev = LIST_FIRST(mvd_snap_t, &mvd->snapshots, entry);
+    lo = 1;
+    hi = mvd->numsnapshots - 1;
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        if (mvd->snapshots[mid]->framenum > framenum)
+            hi = mid - 1;
+        else
+            lo = mid + 1;
+    }
 
-    LIST_FOR_EACH(mvd_snap_t, snap, &mvd->snapshots, entry) {
-        if (snap->framenum > framenum)
-            break;
-        prev = snap;
+    return mvd->snapshots[lo - 1];
+}
+
+/*
+Seek index is a sidecar file next to the demo containing snapshots of the
+first map, so that demo can be seeked without parsing it up to the
+destination point first. It is written by `mvdindex' command.
+*/
+
+#define MVD_INDEX_MAGIC     MakeRawLong('M','V','D','I')
+#define MVD_INDEX_VERSION   1
+
+typedef struct {
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    demosize[2];    // low, high
+    uint32_t    servercount;
+    uint32_t    numsnaps;
+    char        mapname[MAX_QPATH];
+} idxheader_t;
+
+typedef struct {
+    uint32_t    framenum;
+    uint32_t    msglen;
+    uint32_t    filepos[2];     // low, high
+} idxsnap_t;
+
+static size_t demo_index_name(gtv_t *gtv, char *buffer, size_t size)
+{
+    return Q_concat(buffer, size, gtv->demoentry->string, ".idx");
+}
+
+static int read_index(gtv_t *gtv, qhandle_t f)
+{
+    mvd_t *mvd = gtv->mvd;
+    idxheader_t header;
+    idxsnap_t rec;
+    mvd_snap_t *snap;
+    int64_t demosize, filepos;
+    int framenum, prevframe;
+    size_t msglen;
+    uint32_t i, numsnaps;
+    int ret;
+
+    ret = FS_Read(&header, sizeof(header), f);
+    if (ret != sizeof(header))
+        return ret < 0 ? ret : Q_ERR_UNEXPECTED_EOF;
+
+    if (header.magic != MVD_INDEX_MAGIC)
+        return Q_ERR_UNKNOWN_FORMAT;
+
+    if (LittleLong(header.version) != MVD_INDEX_VERSION)
+        return Q_ERR_UNKNOWN_FORMAT;
+
+    // make sure index belongs to this demo
+    demosize = LittleLong(header.demosize[0]) |
+        (int64_t)LittleLong(header.demosize[1]) << 32;
+    if (demosize != gtv->demosize ||
+        (int)LittleLong(header.servercount) != mvd->servercount ||
+        strncmp(header.mapname, mvd->mapname, sizeof(header.mapname)))
+        return Q_ERR_INVALID_FORMAT;
+
+    numsnaps = LittleLong(header.numsnaps);
+    prevframe = INT_MIN;
+    for (i = 0; i < numsnaps; i++) {
+        ret = FS_Read(&rec, sizeof(rec), f);
+        if (ret != sizeof(rec))
+            return ret < 0 ? ret : Q_ERR_UNEXPECTED_EOF;
+
+        framenum = LittleLong(rec.framenum);
+        msglen = LittleLong(rec.msglen);
+        filepos = LittleLong(rec.filepos[0]) |
+            (int64_t)LittleLong(rec.filepos[1]) << 32;
+
+        if (framenum <= prevframe)
+            return Q_ERR_INVALID_FORMAT;
+        if (!msglen || msglen > MAX_MSGLEN)
+            return Q_ERR_INVALID_FORMAT;
+        if (filepos < gtv->demopos || filepos > gtv->demosize)
+            return Q_ERR_BAD_EXTENT;
+
+        snap = MVD_Malloc(sizeof(*snap) + msglen - 1);
+        snap->framenum = framenum;
+        snap->filepos = filepos;
+        snap->msglen = msglen;
+        demo_add_snapshot(mvd, snap);
+
+        ret = FS_Read(snap->data, msglen, f);
+        if (ret != msglen)
+            return ret < 0 ? ret : Q_ERR_UNEXPECTED_EOF;
+
+        prevframe = framenum;
     }
 
-    return prev;
+    return Q_ERR_SUCCESS;
+}
+
+// loads snapshots from seek index, if there is one
+static void demo_load_index(gtv_t *gtv)
+{
+    mvd_t *mvd = gtv->mvd;
+    char buffer[MAX_OSPATH];
+    qhandle_t f;
+    int ret;
+
+    if (!gtv->demosize)
+        return;
+
+    if (demo_index_name(gtv, buffer, sizeof(buffer)) >= sizeof(buffer))
+        return;
+
+    FS_FOpenFile(buffer, &f, FS_MODE_READ);
+    if (!f)
+        return;
+
+    ret = read_index(gtv, f);
+    FS_FCloseFile(f);
+
+    if (ret) {
+        Com_WPrintf("[%s] Couldn't load %s: %s\n", gtv->name, buffer, Q_ErrorString(ret));
+        MVD_FreeSnapshots(mvd);
+        return;
+    }
+
+    if (mvd->numsnapshots) {
+        mvd->last_snapshot = mvd->snapshots[mvd->numsnapshots - 1]->framenum;
+        Com_DPrintf("[%s] Loaded %d snapshots from %s\n", gtv->name, mvd->numsnapshots, buffer);
+    }
+}
+
+static int write_index(gtv_t *gtv, qhandle_t f)
+{
+    mvd_t *mvd = gtv->mvd;
+    idxheader_t header;
+    idxsnap_t rec;
+    mvd_snap_t *snap;
+    int i, ret;
+
+    memset(&header, 0, sizeof(header));
+    header.magic = MVD_INDEX_MAGIC;
+    header.version = LittleLong(MVD_INDEX_VERSION);
+    header.demosize[0] = LittleLong((uint32_t)gtv->demosize);
+    header.demosize[1] = LittleLong((uint32_t)(gtv->demosize >> 32));
+    header.servercount = LittleLong(mvd->servercount);
+    header.numsnaps = LittleLong(mvd->numsnapshots);
+    Q_strlcpy(header.mapname, mvd->mapname, sizeof(header.mapname));
+
+    ret = FS_Write(&header, sizeof(header), f);
+    if (ret != sizeof(header))
+        return ret < 0 ? ret : Q_ERR_FAILURE;
+
+    for (i = 0; i < mvd->numsnapshots; i++) {
+        snap = mvd->snapshots[i];
+
+        rec.framenum = LittleLong(snap->framenum);
+        rec.msglen = LittleLong(snap->msglen);
+        rec.filepos[0] = LittleLong((uint32_t)snap->filepos);
+        rec.filepos[1] = LittleLong((uint32_t)(snap->filepos >> 32));
+
+        ret = FS_Write(&rec, sizeof(rec), f);
+        if (ret != sizeof(rec))
+            return ret < 0 ? ret : Q_ERR_FAILURE;
+
+        ret = FS_Write(snap->data, snap->msglen, f);
+        if (ret != snap->msglen)
+            return ret < 0 ? ret : Q_ERR_FAILURE;
+    }
+
+    return Q_ERR_SUCCESS;
+}
+
+static void demo_save_index(gtv_t *gtv)
+{
+    char buffer[MAX_OSPATH];
+    qhandle_t f;
+    int ret, err;
+
+    if (demo_index_name(gtv, buffer, sizeof(buffer)) >= sizeof(buffer)) {
+        Com_Printf("Oversize index filename specified.\n");
+        return;
+    }
+
+    ret = FS_FOpenFile(buffer, &f, FS_MODE_WRITE);
+    if (!f) {
+        Com_EPrintf("[%s] Couldn't open %s: %s\n", gtv->name, buffer, Q_ErrorString(ret));
+        return;
+    }
+
+    ret = write_index(gtv, f);
+    err = FS_FCloseFile(f);
+    if (!ret)
+        ret = err;
+    if (ret) {
+        Com_EPrintf("[%s] Couldn't write %s: %s\n", gtv->name, buffer, Q_ErrorString(ret));
+        return;
+    }
+
+    Com_Printf("[%s] Wrote %d snapshots into %s\n", gtv->name, gtv->mvd->numsnapshots, buffer);
 }
 
 static void demo_update(gtv_t *gtv)
@@ -674,11 +903,15 @@ static bool demo_read_frame(mvd_t *mvd)
                 goto next;
             }
         } while (--count);
+        gtv->demofirstmap = false;
     } else {
         ret = demo_read_message(gtv->demoplayback);
         if (ret <= 0) {
             goto next;
         }
+        if ((msg_read_buffer[0] & SVCMD_MASK) == mvd_serverdata) {
+            gtv->demofirstmap = false;
+        }
     }
 
     demo_update(gtv);
@@ -752,7 +985,9 @@ static void demo_play_next(gtv_t *gtv, string_entry_t *entry)
     if (gtv->demosize < 0 || gtv->demopos < 0) {
         gtv->demosize = gtv->demopos = 0;
     }
+    gtv->demofirstmap = true;
 
+    demo_load_index(gtv);
     demo_emit_snapshot(gtv->mvd);
 }
 
@@ -2128,62 +2363,15 @@ static void MVD_Skip_f(void)
     mvd->gtv->demoskip = count;
 }
 
-static void MVD_Seek_f(void)
+static void demo_seek(mvd_t *mvd, int dest)
 {
-    mvd_t *mvd;
-    gtv_t *gtv;
+    gtv_t *gtv = mvd->gtv;
     mvd_snap_t *snap;
-    int i, j, ret, index, frames, dest;
+    int i, j, ret, index;
     char *from, *to;
     edict_t *ent;
     bool gamestate;
 
-    if (Cmd_Argc() < 2) {
-        Com_Printf("Usage: %s [+-]<timespec> [chanid]\n", Cmd_Argv(0));
-        return;
-    }
-
-    mvd = MVD_SetChannel(2);
-    if (!mvd) {
-        return;
-    }
-
-    gtv = mvd->gtv;
-    if (!gtv || !gtv->demoplayback) {
-        Com_Printf("[%s] Seeking is only supported on demo channels.\n", mvd->name);
-        return;
-    }
-
-    if (mvd->demorecording) {
-        // need some sort of nodelta frame support for that :(
-        Com_Printf("[%s] Seeking is not yet supported during demo recording, sorry.\n", mvd->name);
-        return;
-    }
-
-    to = Cmd_Argv(1);
-
-    if (*to == '-' || *to == '+') {
-        // relative to current frame
-        if (!Com_ParseTimespec(to + 1, &frames)) {
-            Com_Printf("Invalid relative timespec.\n");
-            return;
-        }
-        if (*to == '-')
-            frames = -frames;
-        dest = mvd->framenum + frames;
-    } else {
-        // relative to first frame
-        if (!Com_ParseTimespec(to, &dest)) {
-            Com_Printf("Invalid absolute timespec.\n");
-            return;
-        }
-        frames = dest - mvd->framenum;
-    }
-
-    if (!frames)
-        // already there
-        return;
-
     if (setjmp(mvd_jmpbuf))
         return;
 
@@ -2196,9 +2384,13 @@ static void MVD_Seek_f(void)
     Com_DPrintf("[%d] seeking to %d\n", mvd->framenum, dest);
 
     // seek to the previous most recent snapshot
-    if (frames < 0 || mvd->last_snapshot > mvd->framenum) {
+    if (dest < mvd->framenum || mvd->last_snapshot > mvd->framenum) {
         snap = demo_find_snapshot(mvd, dest);
 
+        // don't go back when skipping forward within a snapshot interval
+        if (snap && dest > mvd->framenum && snap->framenum <= mvd->framenum)
+            snap = NULL;
+
         if (snap) {
             Com_DPrintf("found snap at %d\n", snap->framenum);
             ret = FS_Seek(gtv->demoplayback, snap->filepos);
@@ -2230,7 +2422,7 @@ static void MVD_Seek_f(void)
 
             MVD_ParseMessage(mvd);
             mvd->framenum = snap->framenum;
-        } else if (frames < 0) {
+        } else if (dest < mvd->framenum) {
             Com_Printf("[%s] Couldn't seek backwards without snapshots!\n", mvd->name);
             goto done;
         }
@@ -2305,6 +2497,134 @@ done:
     mvd->demoseeking = false;
 }
 
+static void MVD_Seek_f(void)
+{
+    mvd_t *mvd;
+    gtv_t *gtv;
+    int frames, dest;
+    char *to;
+
+    if (Cmd_Argc() < 2) {
+        Com_Printf("Usage: %s [+-]<timespec> [chanid]\n", Cmd_Argv(0));
+        return;
+    }
+
+    mvd = MVD_SetChannel(2);
+    if (!mvd) {
+        return;
+    }
+
+    gtv = mvd->gtv;
+    if (!gtv || !gtv->demoplayback) {
+        Com_Printf("[%s] Seeking is only supported on demo channels.\n", mvd->name);
+        return;
+    }
+
+    if (mvd->demorecording) {
+        // need some sort of nodelta frame support for that :(
+        Com_Printf("[%s] Seeking is not yet supported during demo recording, sorry.\n", mvd->name);
+        return;
+    }
+
+    to = Cmd_Argv(1);
+
+    if (*to == '-' || *to == '+') {
+        // relative to current frame
+        if (!Com_ParseTimespec(to + 1, &frames)) {
+            Com_Printf("Invalid relative timespec.\n");
+            return;
+        }
+        if (*to == '-')
+            frames = -frames;
+        dest = mvd->framenum + frames;
+    } else {
+        // relative to first frame
+        if (!Com_ParseTimespec(to, &dest)) {
+            Com_Printf("Invalid absolute timespec.\n");
+            return;
+        }
+        frames = dest - mvd->framenum;
+    }
+
+    if (!frames)
+        // already there
+        return;
+
+    demo_seek(mvd, dest);
+}
+
+static void MVD_Index_f(void)
+{
+    mvd_t *mvd;
+    gtv_t *gtv;
+    int ret, framenum;
+
+    mvd = MVD_SetChannel(1);
+    if (!mvd) {
+        return;
+    }
+
+    gtv = mvd->gtv;
+    if (!gtv || !gtv->demoplayback) {
+        Com_Printf("[%s] Indexing is only supported on demo channels.\n", mvd->name);
+        return;
+    }
+
+    if (mvd->demorecording) {
+        Com_Printf("[%s] Indexing is not supported during demo recording.\n", mvd->name);
+        return;
+    }
+
+    if (!gtv->demosize) {
+        Com_Printf("[%s] Demo is not seekable.\n", mvd->name);
+        return;
+    }
+
+    // index is only loaded when demo starts playing
+    if (!gtv->demofirstmap) {
+        Com_Printf("[%s] Indexing is only supported on the first map of demo.\n", mvd->name);
+        return;
+    }
+
+    if (mvd_snaps->integer <= 0) {
+        Com_Printf("[%s] Snapshots are disabled.\n", mvd->name);
+        return;
+    }
+
+    framenum = mvd->framenum;
+
+    if (setjmp(mvd_jmpbuf))
+        return;
+
+    mvd->demoseeking = true;
+
+    // parse the rest of current map, building snapshots
+    while (1) {
+        ret = demo_read_message(gtv->demoplayback);
+        if (ret <= 0)
+            break;
+        if ((msg_read_buffer[0] & SVCMD_MASK) == mvd_serverdata)
+            break;
+        MVD_ParseMessage(mvd);
+        demo_emit_snapshot(mvd);
+    }
+
+    mvd->demoseeking = false;
+
+    if (ret < 0) {
+        Com_EPrintf("[%s] Couldn't read %s: %s\n", mvd->name,
+                    gtv->demoentry->string, Q_ErrorString(ret));
+    } else {
+        demo_save_index(gtv);
+    }
+
+    // go back to where we were
+    if (mvd->framenum == framenum)
+        FS_Seek(gtv->demoplayback, gtv->demopos);
+    else
+        demo_seek(mvd, framenum);
+}
+
 static void MVD_Control_f(void)
 {
     static const cmd_option_t options[] = {
@@ -2542,6 +2862,7 @@ static const cmdreg_t c_mvd[] = {
     { "mvdpause", MVD_Pause_f },
     { "mvdskip", MVD_Skip_f },
     { "mvdseek", MVD_Seek_f },
+    { "mvdindex", MVD_Index_f },
 
     { NULL }
 };
@@ -113,7 +113,6 @@ typedef enum {
 } mvd_state_t;
 
 typedef struct {
-    list_t entry;
     int framenum;
     int64_t filepos;
     size_t msglen;
@@ -139,7 +138,8 @@ typedef struct mvd_s {
     char        *demoname;
     bool        demoseeking;
     int         last_snapshot;
-    list_t      snapshots;
+    mvd_snap_t  **snapshots;    // sorted by framenum
+    int         numsnapshots;
 
     // delay buffer
     fifo_t      delay;
@@ -195,6 +195,7 @@ extern cvar_t    *mvd_shownet;
 #endif
 
 void MVD_Destroyf(mvd_t *mvd, const char *fmt, ...) q_noreturn q_printf(2, 3);
+void MVD_FreeSnapshots(mvd_t *mvd);
 void MVD_Shutdown(void);
 
 mvd_t *MVD_SetChannel(int arg);
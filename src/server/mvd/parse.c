@@ -154,6 +154,7 @@ static void MVD_ParseMulticast(mvd_t *mvd, mvd_ops_t op, int extrabits)
     mvd_client_t    *client;
     client_t    *cl;
     byte        mask[VIS_MAX_BYTES];
+    const byte  *vis = NULL;
     mleaf_t     *leaf1 = NULL, *leaf2;
     vec3_t      org;
     bool        reliable = false;
@@ -176,7 +177,7 @@ static void MVD_ParseMulticast(mvd_t *mvd, mvd_ops_t op, int extrabits)
         leafnum = MSG_ReadWord();
         if (!mvd->demoseeking) {
             leaf1 = CM_LeafNum(&mvd->cm, leafnum);
-            BSP_ClusterVis(mvd->cm.cache, mask, leaf1->cluster, DVIS_PHS);
+            vis = BSP_GetClusterVis(mvd->cm.cache, mask, leaf1->cluster, DVIS_PHS);
         }
         break;
     case mvd_multicast_pvs_r:
@@ -186,7 +187,7 @@ static void MVD_ParseMulticast(mvd_t *mvd, mvd_ops_t op, int extrabits)
         leafnum = MSG_ReadWord();
         if (!mvd->demoseeking) {
             leaf1 = CM_LeafNum(&mvd->cm, leafnum);
-            BSP_ClusterVis(mvd->cm.cache, mask, leaf1->cluster, DVIS_PVS);
+            vis = BSP_GetClusterVis(mvd->cm.cache, mask, leaf1->cluster, DVIS_PVS);
         }
         break;
     default:
@@ -222,7 +223,7 @@ static void MVD_ParseMulticast(mvd_t *mvd, mvd_ops_t op, int extrabits)
                 continue;
             if (leaf2->cluster == -1)
                 continue;
-            if (!Q_IsBitSet(mask, leaf2->cluster))
+            if (!Q_IsBitSet(vis, leaf2->cluster))
                 continue;
         }
 
@@ -479,6 +480,7 @@ static void MVD_ParseSound(mvd_t *mvd, int extrabits)
     mvd_client_t        *client;
     client_t    *cl;
     byte        mask[VIS_MAX_BYTES];
+    const byte  *vis = NULL;
     mleaf_t     *leaf1, *leaf2;
     message_packet_t    *msg;
     edict_t     *entity;
@@ -537,7 +539,7 @@ static void MVD_ParseSound(mvd_t *mvd, int extrabits)
     leaf1 = NULL;
     if (!(extrabits & 1)) {
         leaf1 = CM_PointLeaf(&mvd->cm, origin);
-        BSP_ClusterVis(mvd->cm.cache, mask, leaf1->cluster, DVIS_PHS);
+        vis = BSP_GetClusterVis(mvd->cm.cache, mask, leaf1->cluster, DVIS_PHS);
     }
 
     FOR_EACH_MVDCL(client, mvd) {
@@ -556,7 +558,7 @@ static void MVD_ParseSound(mvd_t *mvd, int extrabits)
                 continue;
             if (leaf2->cluster == -1)
                 continue;
-            if (!Q_IsBitSet(mask, leaf2->cluster))
+            if (!Q_IsBitSet(vis, leaf2->cluster))
                 continue;
         }
 
@@ -840,7 +842,6 @@ static void MVD_ParseFrame(mvd_t *mvd)
 void MVD_ClearState(mvd_t *mvd, bool full)
 {
     mvd_player_t *player;
-    mvd_snap_t *snap, *next;
     int i;
 
     // clear all entities, don't trust num_edicts as it is possible
@@ -861,11 +862,7 @@ void MVD_ClearState(mvd_t *mvd, bool full)
         return;
 
     // free all snapshots
-    LIST_FOR_EACH_SAFE(mvd_snap_t, snap, next, &mvd->snapshots, entry) {
-        Z_Free(snap);
-    }
-
-    List_Init(&mvd->snapshots);
+    MVD_FreeSnapshots(mvd);
 
     // free current map
     CM_FreeMap(&mvd->cm);
@@ -0,0 +1,268 @@
+/*
+Copyright (C) 2026 Q2PRO contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+//
+// profile.c -- server frame profiler
+//
+
+#include "server.h"
+
+// number of server ticks kept for percentile calculation
+#define PROF_SAMPLES    1024
+
+typedef struct {
+    uint32_t    time;       // total microseconds spent this tick
+    uint32_t    count;      // number of times scope was entered
+    uint32_t    max;        // longest single call
+} profsample_t;
+
+static const char *const prof_names[PROF_NUM_SCOPES] = {
+    "frame",
+    "packets",
+    "game",
+    "build",
+    "datagram",
+    "mvd",
+    "async",
+};
+
+static struct {
+    profsample_t    current[PROF_NUM_SCOPES];
+    profsample_t    samples[PROF_SAMPLES][PROF_NUM_SCOPES];
+    unsigned        head;           // next sample to be written
+    unsigned        filled;         // number of valid samples
+    unsigned        overruns;       // ticks that took longer than frame time
+    unsigned        ticks;          // total ticks since reset
+    unsigned        csv_ticks;      // ticks since last CSV line
+    unsigned        csv_time;
+    qhandle_t       csv_file;
+} prof;
+
+bool sv_profiling;
+
+static cvar_t   *sv_profile_interval;
+
+/*
+===============
+SV_ProfileAdd
+
+Accounts time spent in the given scope to the current tick.
+===============
+*/
+void SV_ProfileAdd(prof_scope_t scope, uint64_t usec)
+{
+    profsample_t *s = &prof.current[scope];
+
+    if (usec > UINT32_MAX)
+        usec = UINT32_MAX;
+
+    s->time += usec;
+    s->count++;
+    s->max = max(s->max, usec);
+}
+
+static int samplecmp(const void *p1, const void *p2)
+{
+    uint32_t a = *(const uint32_t *)p1;
+    uint32_t b = *(const uint32_t *)p2;
+
+    return a < b ? -1 : a > b;
+}
+
+typedef struct {
+    unsigned    calls;
+    unsigned    avg, p50, p90, p99, max;
+    unsigned    call;   // longest single call
+} profstats_t;
+
+// calculates statistics over the last `count' ticks
+static void calc_stats(prof_scope_t scope, unsigned count, profstats_t *st)
+{
+    static uint32_t times[PROF_SAMPLES];
+    uint64_t total = 0;
+    unsigned i, calls = 0;
+
+    memset(st, 0, sizeof(*st));
+    if (!count)
+        return;
+
+    for (i = 0; i < count; i++) {
+        const profsample_t *s = &prof.samples[(prof.head - 1 - i) & (PROF_SAMPLES - 1)][scope];
+        times[i] = s->time;
+        total += s->time;
+        calls += s->count;
+        st->call = max(st->call, s->max);
+    }
+
+    qsort(times, count, sizeof(times[0]), samplecmp);
+
+    st->calls = calls / count;
+    st->avg = total / count;
+    st->p50 = times[count * 50 / 100];
+    st->p90 = times[count * 90 / 100];
+    st->p99 = times[count * 99 / 100];
+    st->max = times[count - 1];
+}
+
+static void close_csv(void)
+{
+    if (prof.csv_file) {
+        FS_FCloseFile(prof.csv_file);
+        prof.csv_file = 0;
+    }
+}
+
+static void write_csv(void)
+{
+    unsigned count = min(prof.csv_ticks, prof.filled);
+    profstats_t st;
+    time_t now;
+    int i;
+
+    now = time(NULL);
+    for (i = 0; i < PROF_NUM_SCOPES; i++) {
+        calc_stats(i, count, &st);
+        FS_FPrintf(prof.csv_file, "%lld,%s,%u,%u,%u,%u,%u,%u,%u,%u\n",
+                   (long long)now, prof_names[i], count, st.calls,
+                   st.avg, st.p50, st.p90, st.p99, st.max, st.call);
+    }
+
+    prof.csv_ticks = 0;
+    prof.csv_time = svs.realtime;
+}
+
+/*
+===============
+SV_ProfileFrame
+
+Called once per server tick after all clients have been sent their frames.
+Moves accumulated timings into the sample history.
+===============
+*/
+void SV_ProfileFrame(void)
+{
+    profsample_t *s;
+
+    if (!sv_profiling)
+        return;
+
+    s = prof.samples[prof.head++ & (PROF_SAMPLES - 1)];
+    memcpy(s, prof.current, sizeof(prof.current));
+    memset(prof.current, 0, sizeof(prof.current));
+
+    if (prof.filled < PROF_SAMPLES)
+        prof.filled++;
+    if (s[PROF_FRAME].time > SV_FRAMETIME * 1000)
+        prof.overruns++;
+    prof.ticks++;
+    prof.csv_ticks++;
+
+    if (prof.csv_file && svs.realtime - prof.csv_time >=
+        Cvar_ClampInteger(sv_profile_interval, 1, 3600) * 1000)
+        write_csv();
+}
+
+static void reset_profile(void)
+{
+    memset(prof.current, 0, sizeof(prof.current));
+    prof.head = prof.filled = 0;
+    prof.overruns = prof.ticks = 0;
+    prof.csv_ticks = 0;
+    prof.csv_time = svs.realtime;
+}
+
+static void start_profile(const char *name)
+{
+    char buffer[MAX_OSPATH];
+
+    close_csv();
+
+    if (name) {
+        prof.csv_file = FS_EasyOpenFile(buffer, sizeof(buffer),
+                                        FS_MODE_APPEND | FS_BUF_LINE | FS_FLAG_TEXT,
+                                        "logs/", name, ".csv");
+        if (!prof.csv_file)
+            return;
+        FS_FPrintf(prof.csv_file, "time,scope,ticks,calls,avg,p50,p90,p99,max,call\n");
+        Com_Printf("Writing profile to %s\n", buffer);
+    }
+
+    reset_profile();
+    sv_profiling = true;
+}
+
+static void stop_profile(void)
+{
+    if (prof.csv_file && prof.csv_ticks)
+        write_csv();
+    close_csv();
+    sv_profiling = false;
+}
+
+static void print_profile(void)
+{
+    profstats_t st;
+    int i;
+
+    if (!prof.filled) {
+        Com_Printf("No profile samples collected.\n");
+        return;
+    }
+
+    Com_Printf("Last %u of %u ticks, %u over %d ms (usec):\n"
+               "scope    calls   avg   p50   p90   p99   max  call\n"
+               "-------- ----- ----- ----- ----- ----- ----- -----\n",
+               prof.filled, prof.ticks, prof.overruns, SV_FRAMETIME);
+
+    for (i = 0; i < PROF_NUM_SCOPES; i++) {
+        calc_stats(i, prof.filled, &st);
+        Com_Printf("%-8s %5u %5u %5u %5u %5u %5u %5u\n", prof_names[i],
+                   st.calls, st.avg, st.p50, st.p90, st.p99, st.max, st.call);
+    }
+}
+
+static void SV_Profile_f(void)
+{
+    char *s = Cmd_Argv(1);
+
+    if (!strcmp(s, "start")) {
+        start_profile(Cmd_Argc() > 2 ? Cmd_Argv(2) : NULL);
+    } else if (!strcmp(s, "stop")) {
+        stop_profile();
+    } else if (!strcmp(s, "reset")) {
+        reset_profile();
+    } else if (!*s) {
+        if (!sv_profiling)
+            Com_Printf("Profiler is not running.\n");
+        print_profile();
+    } else {
+        Com_Printf("Usage: %s [start [csvfile]|stop|reset]\n", Cmd_Argv(0));
+    }
+}
+
+/*
+===============
+SV_RegisterProfile
+===============
+*/
+void SV_RegisterProfile(void)
+{
+    Cmd_AddCommand("sv_profile", SV_Profile_f);
+
+    sv_profile_interval = Cvar_Get("sv_profile_interval", "10", 0);
+}
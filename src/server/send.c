@@ -238,6 +238,165 @@ void SV_BroadcastCommand(const char *fmt, ...)
 }
 
 
+/*
+=================
+SV_ClientLeaf
+
+Returns leaf containing client entity origin. Cached until the entity is
+relinked or its origin changes.
+=================
+*/
+mleaf_t *SV_ClientLeaf(client_t *client)
+{
+    edict_t *ent = client->edict;
+
+    if (!client->leaf || !VectorCompare(client->leaf_origin, ent->s.origin)) {
+        client->leaf = CM_PointLeaf(&sv.cm, ent->s.origin);
+        VectorCopy(ent->s.origin, client->leaf_origin);
+    }
+
+    return client->leaf;
+}
+
+/*
+=============================================================================
+
+Batched multicasts
+
+When ‘sv_multicast_batch’ is enabled, unreliable multicasts issued by the
+game while running a frame are queued and delivered to clients at the end
+of the frame. Client visibility is then calculated once for each run of multicasts
+sharing the same cluster and area.
+
+=============================================================================
+*/
+
+#define MULTICAST_QUEUE_SIZE    0x10000
+
+typedef struct {
+    uint16_t    len;
+    int16_t     cluster;    // -2 for MULTICAST_ALL
+    int16_t     area;
+    uint8_t     vis;        // DVIS_PVS or DVIS_PHS
+} queued_multicast_t;
+
+static byte     mc_queue[MULTICAST_QUEUE_SIZE];
+static size_t   mc_queuesize;
+static bool     mc_batching;
+
+static bool client_can_see(client_t *client, int cluster, int area, const byte *vis)
+{
+    mleaf_t *leaf = SV_ClientLeaf(client);
+
+    if (!CM_AreasConnected(&sv.cm, area, leaf->area))
+        return false;
+    if (leaf->cluster == -1)
+        return false;
+    if (!Q_IsBitSet(vis, leaf->cluster))
+        return false;
+    return true;
+}
+
+static void flush_multicasts(void)
+{
+    static bool send[MAX_CLIENTS];
+    byte        mask[VIS_MAX_BYTES];
+    const byte  *vis = NULL;
+    queued_multicast_t m, last;
+    client_t    *client;
+    size_t      pos;
+    bool        first = true;
+
+    for (pos = 0; pos < mc_queuesize; pos += m.len) {
+        memcpy(&m, mc_queue + pos, sizeof(m));
+        pos += sizeof(m);
+
+        // find clients for a new run of multicasts
+        if (first || m.cluster != last.cluster || m.area != last.area || m.vis != last.vis) {
+            if (m.cluster != -2)
+                vis = BSP_GetClusterVis(sv.cm.cache, mask, m.cluster, m.vis);
+            FOR_EACH_CLIENT(client) {
+                send[client->number] = CLIENT_ACTIVE(client) &&
+                    (m.cluster == -2 || client_can_see(client, m.cluster, m.area, vis));
+            }
+            last = m;
+            first = false;
+        }
+
+        SZ_Write(&msg_write, mc_queue + pos, m.len);
+        FOR_EACH_CLIENT(client) {
+            if (send[client->number])
+                SV_ClientAddMessage(client, 0);
+        }
+        SZ_Clear(&msg_write);
+    }
+
+    mc_queuesize = 0;
+}
+
+/*
+=================
+SV_BeginMulticasts
+
+Called before running game frame, starts queueing multicasts if enabled.
+=================
+*/
+void SV_BeginMulticasts(void)
+{
+    // anything left here is from an aborted frame
+    mc_queuesize = 0;
+    mc_batching = sv_multicast_batch->integer && sv.state == ss_game;
+}
+
+/*
+=================
+SV_FlushMulticasts
+
+Delivers multicasts queued during game frame.
+=================
+*/
+void SV_FlushMulticasts(void)
+{
+    mc_batching = false;
+
+    if (!mc_queuesize)
+        return;
+
+    // should not happen
+    if (msg_write.cursize) {
+        Com_WPrintf("%s: %zu bytes in multicast buffer, cleared.\n",
+                    __func__, msg_write.cursize);
+        SZ_Clear(&msg_write);
+    }
+
+    flush_multicasts();
+}
+
+static void queue_multicast(mleaf_t *leaf, int vis)
+{
+    queued_multicast_t m;
+
+    if (mc_queuesize + sizeof(m) + msg_write.cursize > sizeof(mc_queue)) {
+        // queue full, deliver what we have so far
+        byte buffer[MAX_MSGLEN];
+        size_t len = msg_write.cursize;
+
+        memcpy(buffer, msg_write.data, len);
+        SZ_Clear(&msg_write);
+        flush_multicasts();
+        SZ_Write(&msg_write, buffer, len);
+    }
+
+    m.len = msg_write.cursize;
+    m.cluster = leaf ? leaf->cluster : -2;
+    m.area = leaf ? leaf->area : 0;
+    m.vis = vis;
+
+    memcpy(mc_queue + mc_queuesize, &m, sizeof(m));
+    memcpy(mc_queue + mc_queuesize + sizeof(m), msg_write.data, m.len);
+    mc_queuesize += sizeof(m) + m.len;
+}
+
 /*
 =================
 SV_Multicast
@@ -256,7 +415,8 @@ void SV_Multicast(vec3_t origin, multicast_t to)
 {
     client_t    *client;
     byte        mask[VIS_MAX_BYTES];
-    mleaf_t     *leaf1 = NULL, *leaf2;
+    const byte  *vis = NULL;
+    mleaf_t     *leaf1 = NULL;
     int         leafnum q_unused = 0;
     int         flags = 0;
 
@@ -276,7 +436,7 @@ void SV_Multicast(vec3_t origin, multicast_t to)
     case MULTICAST_PHS:
         leaf1 = CM_PointLeaf(&sv.cm, origin);
         leafnum = leaf1 - sv.cm.cache->leafs;
-        BSP_ClusterVis(sv.cm.cache, mask, leaf1->cluster, DVIS_PHS);
+        vis = BSP_GetClusterVis(sv.cm.cache, mask, leaf1->cluster, DVIS_PHS);
         break;
     case MULTICAST_PVS_R:
         flags |= MSG_RELIABLE;
@@ -284,12 +444,19 @@ void SV_Multicast(vec3_t origin, multicast_t to)
     case MULTICAST_PVS:
         leaf1 = CM_PointLeaf(&sv.cm, origin);
         leafnum = leaf1 - sv.cm.cache->leafs;
-        BSP_ClusterVis(sv.cm.cache, mask, leaf1->cluster, DVIS_PVS);
+        vis = BSP_GetClusterVis(sv.cm.cache, mask, leaf1->cluster, DVIS_PVS);
         break;
     default:
         Com_Error(ERR_DROP, "SV_Multicast: bad to: %i", to);
     }
 
+    // defer unreliable messages until the end of frame
+    if (mc_batching && !(flags & MSG_RELIABLE) &&
+        !(leaf1 && leaf1->cluster == -1)) {
+        queue_multicast(leaf1, to == MULTICAST_PVS ? DVIS_PVS : DVIS_PHS);
+        goto finish;
+    }
+
     // send the data to all relevent clients
     FOR_EACH_CLIENT(client) {
         if (client->state < cs_primed) {
@@ -300,19 +467,14 @@ void SV_Multicast(vec3_t origin, multicast_t to)
             continue;
         }
 
-        if (leaf1) {
-            leaf2 = CM_PointLeaf(&sv.cm, client->edict->s.origin);
-            if (!CM_AreasConnected(&sv.cm, leaf1->area, leaf2->area))
-                continue;
-            if (leaf2->cluster == -1)
-                continue;
-            if (!Q_IsBitSet(mask, leaf2->cluster))
-                continue;
+        if (leaf1 && !client_can_see(client, leaf1->cluster, leaf1->area, vis)) {
+            continue;
         }
 
         SV_ClientAddMessage(client, flags);
     }
 
+finish:
     // add to MVD datagram
     SV_MvdMulticast(leafnum, to);
 
@@ -720,6 +882,19 @@ static void repack_unreliables(client_t *client, size_t maxsize)
     }
 }
 
+static void write_frame(client_t *client)
+{
+    // frame may have been already encoded by worker thread
+    if (client->framebuf.cursize && !client->framebuf.overflowed) {
+        MSG_WriteData(client->framebuf.data, client->framebuf.cursize);
+        SZ_Clear(&client->framebuf);
+    } else {
+        // encode again on main thread, where errors are safe to raise
+        SZ_Clear(&client->framebuf);
+        client->WriteFrame(client);
+    }
+}
+
 static void write_datagram_old(client_t *client)
 {
     message_packet_t *msg;
@@ -741,7 +916,7 @@ static void write_datagram_old(client_t *client)
 
     // send over all the relevant entity_state_t
     // and the player_state_t
-    client->WriteFrame(client);
+    write_frame(client);
     if (msg_write.cursize > maxsize) {
         SV_DPrintf(0, "Frame %d overflowed for %s: %zu > %zu\n",
                    client->framenum, client->name, msg_write.cursize, maxsize);
@@ -801,7 +976,7 @@ static void write_datagram_new(client_t *client)
 
     // send over all the relevant entity_state_t
     // and the player_state_t
-    client->WriteFrame(client);
+    write_frame(client);
 
     if (msg_write.overflowed) {
         // should never really happen
@@ -889,13 +1064,21 @@ Clients in earlier connection state are handled in SV_SendAsyncPackets.
 */
 void SV_SendClientMessages(void)
 {
+    static client_t *clients[MAX_CLIENTS];
     client_t    *client;
     size_t      cursize;
+    uint64_t    start;
+    int         i, count;
+    bool        threaded;
+
+    // queue all datagrams sent this frame and flush them at once
+    NET_BeginBatch(NS_SERVER);
 
-    // send a message to each connected client
+    // find clients that need a new frame
+    count = 0;
     FOR_EACH_CLIENT(client) {
         if (!CLIENT_ACTIVE(client))
-            goto finish;
+            continue;
 
         if (!SV_CLIENTSYNC(client))
             continue;
@@ -910,30 +1093,64 @@ void SV_SendClientMessages(void)
         if (client->netchan->message.overflowed) {
             SZ_Clear(&client->netchan->message);
             SV_DropClient(client, "reliable message overflowed");
-            goto finish;
+            continue;
         }
 
         // don't overrun bandwidth
         if (SV_RateDrop(client))
-            goto advance;
+            continue;
 
         // don't write any frame data until all fragments are sent
         if (client->netchan->fragment_pending) {
             client->frameflags |= FF_SUPPRESSED;
             cursize = client->netchan->TransmitNextFragment(client->netchan);
             SV_CalcSendTime(client, cursize);
-            goto advance;
+            continue;
         }
 
-        // build the new frame and write it
-        SV_BuildClientFrame(client);
+        clients[count++] = client;
+    }
+
+    SV_PrepareClientFrames(clients, count);
+
+    // build the new frames and write them, debug printing
+    // is not thread safe so use single thread for developer
+    threaded = sv_threads->integer > 1;
+#ifdef _DEBUG
+    if (developer->integer)
+        threaded = false;
+#endif
+
+    if (threaded) {
+        start = SV_ProfileStart();
+        SV_EncodeClientFrames(clients, count);
+        SV_ProfileEnd(PROF_BUILD, start);
+    } else {
+        for (i = 0; i < count; i++) {
+            start = SV_ProfileStart();
+            SV_BuildClientFrame(clients[i]);
+            SV_ProfileEnd(PROF_BUILD, start);
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        client = clients[i];
+        start = SV_ProfileStart();
         client->WriteDatagram(client);
+        SV_ProfileEnd(PROF_DATAGRAM, start);
+    }
 
-advance:
-        // advance for next frame
-        client->framenum++;
+    NET_FlushBatch(NS_SERVER);
+
+    FOR_EACH_CLIENT(client) {
+        if (CLIENT_ACTIVE(client)) {
+            if (!SV_CLIENTSYNC(client))
+                continue;
+
+            // advance for next frame
+            client->framenum++;
+        }
 
-finish:
         // clear all unreliable messages still left
         finish_frame(client);
     }
@@ -1065,6 +1282,9 @@ void SV_ShutdownClientSend(client_t *client)
 {
     free_all_messages(client);
 
+    Z_Free(client->framebuf.data);
+    memset(&client->framebuf, 0, sizeof(client->framebuf));
+
     Z_Free(client->msg_pool);
     client->msg_pool = NULL;
 
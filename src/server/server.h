@@ -108,8 +108,17 @@ typedef struct {
     int         latency;
 } client_frame_t;
 
+// size of a bit mask with one bit per entity
+#define ENT_MASK_BYTES      (MAX_EDICTS >> 3)
+#define ENT_MASK_LONGS      (ENT_MASK_BYTES / sizeof(size_t))
+
 typedef struct {
     int         solid32;
+    struct areanode_s   *areanode;  // valid while edict is linked
+
+    // clusters this entity is listed in sv.clusterents
+    int         num_visclusters;
+    uint16_t    visclusters[MAX_ENT_CLUSTERS];
 
 #if USE_FPS
 
@@ -163,6 +172,10 @@ typedef struct {
 
     char        configstrings[MAX_CONFIGSTRINGS][MAX_QPATH];
 
+    // entities last linked into each PVS cluster, ENT_MASK_BYTES per cluster
+    byte        *clusterents;
+    int         numclusters;
+
     server_entity_t entities[MAX_EDICTS];
 } server_t;
 
@@ -266,12 +279,17 @@ typedef struct {
 
 typedef struct client_s {
     list_t          entry;
+    list_t          hashentry;  // sv_clienthash bucket, keyed by base address
 
     // core info
     clstate_t       state;
     edict_t         *edict;     // EDICT_NUM(clientnum+1)
     int             number;     // client slot number
 
+    // leaf containing edict origin, see SV_ClientLeaf
+    mleaf_t         *leaf;
+    vec3_t          leaf_origin;
+
     // client flags
     bool            reconnected: 1;
     bool            nodata: 1;
@@ -318,6 +336,8 @@ typedef struct client_s {
     int             framediv;
 #endif
     unsigned        frameflags;
+    sizebuf_t       framebuf;       // pre-encoded by worker thread
+    struct client_s *framesource;   // MVD spectator sharing entities of this client
 
     // rate dropping
     unsigned        message_size[RATE_MESSAGES];    // used to rate drop normal packets
@@ -325,7 +345,8 @@ typedef struct client_s {
     unsigned        send_time, send_delta;          // used to rate drop async packets
 
     // current download
-    byte            *download;      // file being downloaded
+    struct dlcache_s    *downloadcache;
+    const byte      *download;      // file being downloaded
     int             downloadsize;   // total bytes (can't use EOF because of paks)
     int             downloadcount;  // bytes sent
     char            *downloadname;  // name of the file
@@ -393,17 +414,6 @@ typedef struct client_s {
 
 //=============================================================================
 
-// MAX_CHALLENGES is made large to prevent a denial
-// of service attack that could cycle all of them
-// out before legitimate users connected
-#define    MAX_CHALLENGES    1024
-
-typedef struct {
-    netadr_t    adr;
-    unsigned    challenge;
-    unsigned    time;
-} challenge_t;
-
 typedef struct {
     list_t      entry;
     netadr_t    addr;
@@ -485,8 +495,6 @@ typedef struct server_static_s {
     ratelimit_t     ratelimit_status;
     ratelimit_t     ratelimit_auth;
     ratelimit_t     ratelimit_rcon;
-
-    challenge_t     challenges[MAX_CHALLENGES]; // to prevent invalid IPs from connecting
 } server_static_t;
 
 //=============================================================================
@@ -526,6 +534,8 @@ extern cvar_t       *sv_debug;
 extern cvar_t       *sv_pad_packets;
 #endif
 extern cvar_t       *sv_novis;
+extern cvar_t       *sv_area_tree;
+extern cvar_t       *sv_threads;
 extern cvar_t       *sv_lan_force_rate;
 extern cvar_t       *sv_calcpings_method;
 extern cvar_t       *sv_changemapcmd;
@@ -547,6 +557,8 @@ extern cvar_t       *sv_rcon_limit;
 extern cvar_t       *sv_uptime;
 
 extern cvar_t       *sv_allow_unconnected_cmds;
+extern cvar_t       *sv_download_cache;
+extern cvar_t       *sv_multicast_batch;
 
 extern cvar_t       *g_features;
 
@@ -617,6 +629,9 @@ void SV_SendClientMessages(void);
 void SV_SendAsyncPackets(void);
 
 void SV_Multicast(vec3_t origin, multicast_t to);
+void SV_BeginMulticasts(void);
+void SV_FlushMulticasts(void);
+mleaf_t *SV_ClientLeaf(client_t *client);
 void SV_ClientPrintf(client_t *cl, int level, const char *fmt, ...) q_printf(3, 4);
 void SV_BroadcastPrintf(int level, const char *fmt, ...) q_printf(2, 3);
 void SV_ClientCommand(client_t *cl, const char *fmt, ...) q_printf(2, 3);
@@ -672,6 +687,38 @@ void SV_MvdStop_f(void);
 #define SV_MvdStop_f()      (void)0
 #endif
 
+//
+// profile.c
+//
+typedef enum {
+    PROF_FRAME,
+    PROF_PACKETS,
+    PROF_GAME,
+    PROF_BUILD,
+    PROF_DATAGRAM,
+    PROF_MVD,
+    PROF_ASYNC,
+
+    PROF_NUM_SCOPES
+} prof_scope_t;
+
+extern bool sv_profiling;
+
+void SV_RegisterProfile(void);
+void SV_ProfileAdd(prof_scope_t scope, uint64_t usec);
+void SV_ProfileFrame(void);
+
+static inline uint64_t SV_ProfileStart(void)
+{
+    return sv_profiling ? Sys_Microseconds() : 0;
+}
+
+static inline void SV_ProfileEnd(prof_scope_t scope, uint64_t start)
+{
+    if (start)
+        SV_ProfileAdd(scope, Sys_Microseconds() - start);
+}
+
 //
 // sv_ac.c
 //
@@ -714,6 +761,8 @@ void SV_New_f(void);
 void SV_Begin_f(void);
 void SV_ExecuteClientMessage(client_t *cl);
 void SV_CloseDownload(client_t *client);
+void SV_InitDownloadCache(void);
+void SV_FlushDownloadCache(void);
 #if USE_FPS
 void SV_AlignKeyFrames(client_t *client);
 #else
@@ -741,7 +790,9 @@ void SV_PrintMiscInfo(void);
 #define ES_INUSE(s) \
     ((s)->modelindex || (s)->effects || (s)->sound || (s)->event)
 
+void SV_PrepareClientFrames(client_t **clients, int count);
 void SV_BuildClientFrame(client_t *client);
+void SV_EncodeClientFrames(client_t **clients, int count);
 void SV_WriteFrameToClient_Default(client_t *client);
 void SV_WriteFrameToClient_Enhanced(client_t *client);
 
@@ -749,6 +800,7 @@ void SV_WriteFrameToClient_Enhanced(client_t *client);
 // sv_game.c
 //
 extern    game_export_t    *ge;
+extern    const game_export_ex_t   *ge_ex;
 
 void SV_InitGameProgs(void);
 void SV_ShutdownGameProgs(void);
@@ -800,6 +852,10 @@ int SV_AreaEdicts(vec3_t mins, vec3_t maxs, edict_t **list, int maxcount, int ar
 // returns the number of pointers filled in
 // ??? does this always return the world?
 
+int SV_RadiusEdicts(const vec3_t origin, float radius, edict_t **list, int maxcount);
+// same as above with both area types, for a cube enclosing the sphere.
+// edicts are returned sorted by entity number.
+
 //===================================================================
 
 //
@@ -446,12 +446,178 @@ void SV_Begin_f(void)
 
 //=============================================================================
 
+/*
+==============================================================================
+
+DOWNLOAD CACHE
+
+Files being downloaded are read once and shared between all clients
+downloading the same file. Compressed and uncompressed variants are cached
+separately. Unreferenced entries are kept around for subsequent downloads
+until total size of the cache exceeds ‘sv_download_cache’ limit.
+
+==============================================================================
+*/
+
+#define DLCACHE_HASH_SIZE   64
+
+typedef struct dlcache_s {
+    list_t      hashentry;
+    list_t      lruentry;
+    unsigned    refcount;
+    bool        hashed;
+    bool        deflate;
+    int         size;
+    byte        *data;
+    char        name[1];
+} dlcache_t;
+
+static list_t   dl_hash[DLCACHE_HASH_SIZE];
+static list_t   dl_lru;             // unreferenced entries, oldest first
+static size_t   dl_cachesize;       // total size of all entries
+
+static void free_dlcache(dlcache_t *entry)
+{
+    if (entry->hashed)
+        List_Remove(&entry->hashentry);
+    dl_cachesize -= entry->size;
+    Z_Free(entry->data);
+    Z_Free(entry);
+}
+
+static void trim_dlcache(size_t limit)
+{
+    dlcache_t *entry, *next;
+
+    LIST_FOR_EACH_SAFE(dlcache_t, entry, next, &dl_lru, lruentry) {
+        if (dl_cachesize <= limit)
+            break;
+        List_Remove(&entry->lruentry);
+        free_dlcache(entry);
+    }
+}
+
+static dlcache_t *find_dlcache(const char *name, bool deflate)
+{
+    dlcache_t *entry;
+    unsigned hash;
+
+    hash = FS_HashPath(name, DLCACHE_HASH_SIZE);
+    LIST_FOR_EACH(dlcache_t, entry, &dl_hash[hash], hashentry) {
+        if (entry->deflate == deflate && !FS_pathcmp(entry->name, name))
+            return entry;
+    }
+
+    return NULL;
+}
+
+static void unhash_dlcache(dlcache_t *entry)
+{
+    List_Remove(&entry->hashentry);
+    entry->hashed = false;
+
+    // referenced entries will be freed by release_dlcache
+    if (!entry->refcount) {
+        List_Remove(&entry->lruentry);
+        free_dlcache(entry);
+    }
+}
+
+// returns cached contents of the open file, reading it in if needed
+static dlcache_t *get_dlcache(const char *name, bool deflate, int size, qhandle_t f)
+{
+    dlcache_t *entry;
+    size_t len;
+
+    entry = find_dlcache(name, deflate);
+    if (entry) {
+        if (entry->size == size) {
+            if (!entry->refcount++)
+                List_Remove(&entry->lruentry);
+            return entry;
+        }
+        // file changed on disk since it was cached
+        unhash_dlcache(entry);
+    }
+
+    len = strlen(name);
+    entry = SV_Malloc(sizeof(*entry) + len);
+    entry->data = SV_Malloc(size);
+    if (FS_Read(entry->data, size, f) != size) {
+        Z_Free(entry->data);
+        Z_Free(entry);
+        return NULL;
+    }
+
+    memcpy(entry->name, name, len + 1);
+    entry->refcount = 1;
+    entry->hashed = true;
+    entry->deflate = deflate;
+    entry->size = size;
+    List_Append(&dl_hash[FS_HashPath(name, DLCACHE_HASH_SIZE)], &entry->hashentry);
+    dl_cachesize += size;
+
+    return entry;
+}
+
+static void release_dlcache(dlcache_t *entry)
+{
+    if (--entry->refcount)
+        return;
+
+    if (!entry->hashed) {
+        free_dlcache(entry);
+        return;
+    }
+
+    List_Append(&dl_lru, &entry->lruentry);
+    trim_dlcache(Cvar_ClampInteger(sv_download_cache, 0, 1024) * 0x100000);
+}
+
+/*
+==================
+SV_FlushDownloadCache
+
+Frees all cached downloads that are not currently in use. Downloads in
+progress keep their data, but are no longer shared with new downloads,
+so that files changed on disk are read in again.
+==================
+*/
+void SV_FlushDownloadCache(void)
+{
+    dlcache_t *entry, *next;
+    int i;
+
+    trim_dlcache(0);
+
+    for (i = 0; i < DLCACHE_HASH_SIZE; i++) {
+        LIST_FOR_EACH_SAFE(dlcache_t, entry, next, &dl_hash[i], hashentry) {
+            unhash_dlcache(entry);
+        }
+    }
+}
+
+/*
+==================
+SV_InitDownloadCache
+==================
+*/
+void SV_InitDownloadCache(void)
+{
+    int i;
+
+    for (i = 0; i < DLCACHE_HASH_SIZE; i++)
+        List_Init(&dl_hash[i]);
+    List_Init(&dl_lru);
+}
+
 void SV_CloseDownload(client_t *client)
 {
-    if (client->download) {
-        Z_Free(client->download);
-        client->download = NULL;
+    if (client->downloadcache) {
+        release_dlcache(client->downloadcache);
+        client->downloadcache = NULL;
     }
+    client->download = NULL;
     if (client->downloadname) {
         Z_Free(client->downloadname);
         client->downloadname = NULL;
@@ -483,10 +649,10 @@ SV_BeginDownload_f
 static void SV_BeginDownload_f(void)
 {
     char    name[MAX_QPATH];
-    byte    *download;
+    dlcache_t *download;
     int     downloadcmd;
     int64_t downloadsize;
-    int     maxdownloadsize, result, offset = 0;
+    int     maxdownloadsize, offset = 0;
     cvar_t  *allow;
     size_t  len;
     qhandle_t f;
@@ -613,16 +779,16 @@ static void SV_BeginDownload_f(void)
         return;
     }
 
-    download = SV_Malloc(downloadsize);
-    result = FS_Read(download, downloadsize, f);
-    if (result != downloadsize) {
+    download = get_dlcache(name, downloadcmd == svc_zdownload, downloadsize, f);
+    if (!download) {
         Com_DPrintf("Couldn't download %s to %s\n", name, sv_client->name);
-        goto fail3;
+        goto fail2;
     }
 
     FS_FCloseFile(f);
 
-    sv_client->download = download;
+    sv_client->downloadcache = download;
+    sv_client->download = download->data;
     sv_client->downloadsize = downloadsize;
     sv_client->downloadcount = offset;
     sv_client->downloadname = SV_CopyString(name);
@@ -632,8 +798,6 @@ static void SV_BeginDownload_f(void)
     Com_DPrintf("Downloading %s to %s\n", name, sv_client->name);
     return;
 
-fail3:
-    Z_Free(download);
 fail2:
     FS_FCloseFile(f);
 fail1:
@@ -31,22 +31,52 @@ FIXME: this use of "area" is different from the bsp file use
 typedef struct areanode_s {
     int     axis;       // -1 = leaf node
     float   dist;
+    float   margin;     // loose overlap past dist, 0 for uniform tree
     struct areanode_s   *children[2];
     list_t  trigger_edicts;
     list_t  solid_edicts;
+    int     numedicts;  // linked directly to this node
+    int     depth;
+    vec3_t  mins, maxs;
 } areanode_t;
 
 #define    AREA_DEPTH    4
 #define    AREA_NODES    32
 
-static areanode_t   sv_areanodes[AREA_NODES];
+// adaptive tree limits
+#define    AREA_MAX_NODES      1024
+#define    AREA_MAX_DEPTH      12
+#define    AREA_SPLIT_EDICTS   8
+#define    AREA_MIN_SIZE       64
+
+static areanode_t   sv_areanodes[AREA_MAX_NODES];
 static int          sv_numareanodes;
+static bool         sv_areaadaptive;
 
-static float    *area_mins, *area_maxs;
+static const float *area_mins, *area_maxs;
 static edict_t  **area_list;
 static int      area_count, area_maxcount;
 static int      area_type;
 
+static areanode_t *SV_AllocAreaNode(int depth, vec3_t mins, vec3_t maxs)
+{
+    areanode_t  *anode;
+
+    anode = &sv_areanodes[sv_numareanodes];
+    sv_numareanodes++;
+
+    List_Init(&anode->trigger_edicts);
+    List_Init(&anode->solid_edicts);
+
+    anode->axis = -1;
+    anode->children[0] = anode->children[1] = NULL;
+    anode->depth = depth;
+    VectorCopy(mins, anode->mins);
+    VectorCopy(maxs, anode->maxs);
+
+    return anode;
+}
+
 /*
 ===============
 SV_CreateAreaNode
@@ -60,15 +90,9 @@ static areanode_t *SV_CreateAreaNode(int depth, vec3_t mins, vec3_t maxs)
     vec3_t      size;
     vec3_t      mins1, maxs1, mins2, maxs2;
 
-    anode = &sv_areanodes[sv_numareanodes];
-    sv_numareanodes++;
-
-    List_Init(&anode->trigger_edicts);
-    List_Init(&anode->solid_edicts);
+    anode = SV_AllocAreaNode(depth, mins, maxs);
 
     if (depth == AREA_DEPTH) {
-        anode->axis = -1;
-        anode->children[0] = anode->children[1] = NULL;
         return anode;
     }
 
@@ -92,6 +116,104 @@ static areanode_t *SV_CreateAreaNode(int depth, vec3_t mins, vec3_t maxs)
     return anode;
 }
 
+/*
+===============
+SV_AreaNodeForEdict
+
+Finds the deepest node below the given one that fully contains entity's
+box, taking loose margins into account.
+===============
+*/
+static areanode_t *SV_AreaNodeForEdict(areanode_t *node, edict_t *ent)
+{
+    float   mid;
+
+    while (node->axis != -1) {
+        mid = 0.5f * (ent->absmin[node->axis] + ent->absmax[node->axis]);
+        if (mid > node->dist && ent->absmin[node->axis] > node->dist - node->margin)
+            node = node->children[0];
+        else if (mid <= node->dist && ent->absmax[node->axis] < node->dist + node->margin)
+            node = node->children[1];
+        else
+            break;        // crosses the node
+    }
+
+    return node;
+}
+
+static void SV_LinkAreaNode(areanode_t *node, edict_t *ent)
+{
+    if (ent->solid == SOLID_TRIGGER)
+        List_Append(&node->trigger_edicts, &ent->area);
+    else
+        List_Append(&node->solid_edicts, &ent->area);
+
+    node->numedicts++;
+    sv.entities[NUM_FOR_EDICT(ent)].areanode = node;
+}
+
+static void SV_PushAreaEdicts(areanode_t *node, list_t *list)
+{
+    areanode_t  *child;
+    edict_t     *check, *next;
+
+    LIST_FOR_EACH_SAFE(edict_t, check, next, list, area) {
+        child = SV_AreaNodeForEdict(node, check);
+        if (child == node)
+            continue;
+
+        List_Remove(&check->area);
+        node->numedicts--;
+        SV_LinkAreaNode(child, check);
+    }
+}
+
+/*
+===============
+SV_SplitAreaNode
+
+Splits overpopulated leaf of the adaptive tree in half along the longest
+axis. Children overlap by a quarter of parent size, so that small entities
+straddling the split plane still sink down instead of piling up here.
+===============
+*/
+static void SV_SplitAreaNode(areanode_t *node)
+{
+    vec3_t  size, mins, maxs;
+    int     axis;
+
+    if (node->depth == AREA_MAX_DEPTH)
+        return;
+    if (sv_numareanodes > AREA_MAX_NODES - 2)
+        return;
+
+    VectorSubtract(node->maxs, node->mins, size);
+    axis = 0;
+    if (size[1] > size[axis])
+        axis = 1;
+    if (size[2] > size[axis])
+        axis = 2;
+    if (size[axis] < AREA_MIN_SIZE * 2)
+        return;
+
+    node->axis = axis;
+    node->dist = 0.5f * (node->maxs[axis] + node->mins[axis]);
+    node->margin = 0.25f * size[axis];
+
+    VectorCopy(node->mins, mins);
+    VectorCopy(node->maxs, maxs);
+    mins[axis] = node->dist;
+    node->children[0] = SV_AllocAreaNode(node->depth + 1, mins, maxs);
+
+    VectorCopy(node->mins, mins);
+    VectorCopy(node->maxs, maxs);
+    maxs[axis] = node->dist;
+    node->children[1] = SV_AllocAreaNode(node->depth + 1, mins, maxs);
+
+    SV_PushAreaEdicts(node, &node->solid_edicts);
+    SV_PushAreaEdicts(node, &node->trigger_edicts);
+}
+
 /*
 ===============
 SV_ClearWorld
@@ -106,10 +228,14 @@ void SV_ClearWorld(void)
 
     memset(sv_areanodes, 0, sizeof(sv_areanodes));
     sv_numareanodes = 0;
+    sv_areaadaptive = sv_area_tree->integer;
 
     if (sv.cm.cache) {
         cm = &sv.cm.cache->models[0];
-        SV_CreateAreaNode(0, cm->mins, cm->maxs);
+        if (sv_areaadaptive)
+            SV_AllocAreaNode(0, cm->mins, cm->maxs);
+        else
+            SV_CreateAreaNode(0, cm->mins, cm->maxs);
     }
 
     // make sure all entities are unlinked
@@ -117,6 +243,51 @@ void SV_ClearWorld(void)
         ent = EDICT_NUM(i);
         ent->area.prev = ent->area.next = NULL;
     }
+
+    // reset cluster index
+    Z_Free(sv.clusterents);
+    sv.clusterents = NULL;
+    sv.numclusters = 0;
+
+    for (i = 0; i < MAX_EDICTS; i++) {
+        sv.entities[i].num_visclusters = 0;
+    }
+
+    if (sv.cm.cache && sv.cm.cache->vis) {
+        sv.numclusters = sv.cm.cache->vis->numclusters;
+        sv.clusterents = SV_Mallocz(sv.numclusters * ENT_MASK_BYTES);
+    }
+}
+
+/*
+===============
+SV_IndexEdict
+
+Moves entity to the index lists of clusters it is now linked in.
+Entities are only removed from the index when relinked, so the index
+is a superset of visible entities, which is fine for frame building.
+Entities linked by headnode are checked every frame instead.
+===============
+*/
+static void SV_IndexEdict(edict_t *ent, int entnum)
+{
+    server_entity_t *sent = &sv.entities[entnum];
+    int i, cluster;
+
+    for (i = 0; i < sent->num_visclusters; i++) {
+        cluster = sent->visclusters[i];
+        Q_ClearBit(sv.clusterents + cluster * ENT_MASK_BYTES, entnum);
+    }
+
+    sent->num_visclusters = 0;
+
+    for (i = 0; i < ent->num_clusters; i++) {
+        cluster = ent->clusternums[i];
+        if (cluster < 0 || cluster >= sv.numclusters)
+            continue;
+        Q_SetBit(sv.clusterents + cluster * ENT_MASK_BYTES, entnum);
+        sent->visclusters[sent->num_visclusters++] = cluster;
+    }
 }
 
 /*
@@ -229,6 +400,7 @@ void PF_UnlinkEdict(edict_t *ent)
 {
     if (!ent->area.prev)
         return;        // not linked in anywhere
+    sv.entities[NUM_FOR_EDICT(ent)].areanode->numedicts--;
     List_Remove(&ent->area);
     ent->area.prev = ent->area.next = NULL;
 }
@@ -283,6 +455,13 @@ void PF_LinkEdict(edict_t *ent)
 
     SV_LinkEdict(&sv.cm, ent);
 
+    if (sv.clusterents)
+        SV_IndexEdict(ent, entnum);
+
+    // player moved, forget cached leaf
+    if (entnum <= sv_maxclients->integer && svs.client_pool)
+        svs.client_pool[entnum - 1].leaf = NULL;
+
     // if first time, make sure old_origin is valid
     if (!ent->linkcount) {
         VectorCopy(ent->s.origin, ent->s.old_origin);
@@ -304,23 +483,16 @@ void PF_LinkEdict(edict_t *ent)
         return;
 
 // find the first node that the ent's box crosses
-    node = sv_areanodes;
-    while (1) {
-        if (node->axis == -1)
-            break;
-        if (ent->absmin[node->axis] > node->dist)
-            node = node->children[0];
-        else if (ent->absmax[node->axis] < node->dist)
-            node = node->children[1];
-        else
-            break;        // crosses the node
+    node = SV_AreaNodeForEdict(sv_areanodes, ent);
+
+    // split overpopulated leafs of adaptive tree
+    if (sv_areaadaptive && node->axis == -1 && node->numedicts >= AREA_SPLIT_EDICTS) {
+        SV_SplitAreaNode(node);
+        node = SV_AreaNodeForEdict(node, ent);
     }
 
     // link it in
-    if (ent->solid == SOLID_TRIGGER)
-        List_Append(&node->trigger_edicts, &ent->area);
-    else
-        List_Append(&node->solid_edicts, &ent->area);
+    SV_LinkAreaNode(node, ent);
 }
 
 
@@ -330,17 +502,10 @@ SV_AreaEdicts_r
 
 ====================
 */
-static void SV_AreaEdicts_r(areanode_t *node)
+static void SV_AreaEdicts_list(list_t *start)
 {
-    list_t      *start;
     edict_t     *check;
 
-    // touch linked edicts
-    if (area_type == AREA_SOLID)
-        start = &node->solid_edicts;
-    else
-        start = &node->trigger_edicts;
-
     LIST_FOR_EACH(edict_t, check, start, area) {
         if (check->solid == SOLID_NOT)
             continue;        // deactivated
@@ -360,14 +525,23 @@ static void SV_AreaEdicts_r(areanode_t *node)
         area_list[area_count] = check;
         area_count++;
     }
+}
+
+static void SV_AreaEdicts_r(areanode_t *node)
+{
+    // touch linked edicts
+    if (area_type & AREA_SOLID)
+        SV_AreaEdicts_list(&node->solid_edicts);
+    if (area_type & AREA_TRIGGERS)
+        SV_AreaEdicts_list(&node->trigger_edicts);
 
     if (node->axis == -1)
         return;        // terminal node
 
     // recurse down both sides
-    if (area_maxs[node->axis] > node->dist)
+    if (area_maxs[node->axis] > node->dist - node->margin)
         SV_AreaEdicts_r(node->children[0]);
-    if (area_mins[node->axis] < node->dist)
+    if (area_mins[node->axis] < node->dist + node->margin)
         SV_AreaEdicts_r(node->children[1]);
 }
 
@@ -376,21 +550,62 @@ static void SV_AreaEdicts_r(areanode_t *node)
 SV_AreaEdicts
 ================
 */
-int SV_AreaEdicts(vec3_t mins, vec3_t maxs, edict_t **list,
-                  int maxcount, int areatype)
+static int SV_AreaEdictsMask(const vec3_t mins, const vec3_t maxs,
+                             edict_t **list, int maxcount, int mask)
 {
     area_mins = mins;
     area_maxs = maxs;
     area_list = list;
     area_count = 0;
     area_maxcount = maxcount;
-    area_type = areatype;
+    area_type = mask;
 
     SV_AreaEdicts_r(sv_areanodes);
 
     return area_count;
 }
 
+int SV_AreaEdicts(vec3_t mins, vec3_t maxs, edict_t **list,
+                  int maxcount, int areatype)
+{
+    // anything but AREA_SOLID has always meant triggers
+    return SV_AreaEdictsMask(mins, maxs, list, maxcount,
+                             areatype == AREA_SOLID ? AREA_SOLID : AREA_TRIGGERS);
+}
+
+static int edictcmp(const void *p1, const void *p2)
+{
+    const edict_t *a = *(const edict_t **)p1;
+    const edict_t *b = *(const edict_t **)p2;
+
+    return (a > b) - (a < b);
+}
+
+/*
+================
+SV_RadiusEdicts
+
+Returns both solid and trigger edicts touching the box enclosing the
+sphere, sorted by entity number, so that game can iterate over them in
+the same order it walks the edict array.
+================
+*/
+int SV_RadiusEdicts(const vec3_t origin, float radius, edict_t **list, int maxcount)
+{
+    vec3_t  mins, maxs;
+    int     i, count;
+
+    for (i = 0; i < 3; i++) {
+        mins[i] = origin[i] - radius;
+        maxs[i] = origin[i] + radius;
+    }
+
+    count = SV_AreaEdictsMask(mins, maxs, list, maxcount, AREA_SOLID | AREA_TRIGGERS);
+    qsort(list, count, sizeof(list[0]), edictcmp);
+
+    return count;
+}
+
 
 //===========================================================================
 
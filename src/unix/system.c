@@ -39,9 +39,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <dlfcn.h>
 #include <errno.h>
 
-#if USE_CLIENT
 #include <pthread.h>
-#endif
 
 #if USE_SDL
 #include <SDL.h>
@@ -166,6 +164,128 @@ void Sys_QueueAsyncWork(asyncwork_t *work)
 /*
 ===============================================================================
 
+PARALLEL WORKERS
+
+===============================================================================
+*/
+
+#define MAX_POOL_THREADS    32
+
+static bool pool_initialized;
+static bool pool_terminate;
+static pthread_mutex_t pool_lock;
+static pthread_cond_t pool_cond;
+static pthread_cond_t pool_done;
+static pthread_t pool_threads[MAX_POOL_THREADS];
+static int pool_numthreads;
+static int pool_limit;
+static unsigned pool_generation;
+static void (*pool_func)(void *, int);
+static void *pool_arg;
+static int pool_count, pool_next, pool_finished;
+
+// called with pool_lock held
+static void run_pool_items(void)
+{
+    int index;
+
+    while (pool_next < pool_count) {
+        index = pool_next++;
+        pthread_mutex_unlock(&pool_lock);
+        pool_func(pool_arg, index);
+        pthread_mutex_lock(&pool_lock);
+        if (++pool_finished == pool_count)
+            pthread_cond_signal(&pool_done);
+    }
+}
+
+static void *pool_thread_func(void *arg)
+{
+    int number = (intptr_t)arg;
+    unsigned generation = 0;
+
+    pthread_mutex_lock(&pool_lock);
+    while (1) {
+        while (generation == pool_generation && !pool_terminate)
+            pthread_cond_wait(&pool_cond, &pool_lock);
+        if (pool_terminate)
+            break;
+        generation = pool_generation;
+        if (number < pool_limit)
+            run_pool_items();
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    return NULL;
+}
+
+static void shutdown_pool(void)
+{
+    int i;
+
+    if (!pool_initialized)
+        return;
+
+    pthread_mutex_lock(&pool_lock);
+    pool_terminate = true;
+    pthread_cond_broadcast(&pool_cond);
+    pthread_mutex_unlock(&pool_lock);
+
+    for (i = 0; i < pool_numthreads; i++)
+        pthread_join(pool_threads[i], NULL);
+
+    pthread_mutex_destroy(&pool_lock);
+    pthread_cond_destroy(&pool_cond);
+    pthread_cond_destroy(&pool_done);
+    pool_numthreads = 0;
+    pool_initialized = false;
+}
+
+void Sys_ParallelFor(int numthreads, int count, void (*func)(void *, int), void *arg)
+{
+    int i;
+
+    numthreads = min(numthreads, MAX_POOL_THREADS + 1);
+    if (numthreads < 2 || count < 2) {
+        for (i = 0; i < count; i++)
+            func(arg, i);
+        return;
+    }
+
+    if (!pool_initialized) {
+        pthread_mutex_init(&pool_lock, NULL);
+        pthread_cond_init(&pool_cond, NULL);
+        pthread_cond_init(&pool_done, NULL);
+        pool_initialized = true;
+    }
+
+    // calling thread does its share of work too
+    while (pool_numthreads < numthreads - 1) {
+        if (pthread_create(&pool_threads[pool_numthreads], NULL,
+                           pool_thread_func, (void *)(intptr_t)pool_numthreads))
+            Sys_Error("Couldn't create worker thread");
+        pool_numthreads++;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    pool_func = func;
+    pool_arg = arg;
+    pool_count = count;
+    pool_next = 0;
+    pool_finished = 0;
+    pool_limit = numthreads - 1;
+    pool_generation++;
+    pthread_cond_broadcast(&pool_cond);
+
+    run_pool_items();
+    while (pool_finished < pool_count)
+        pthread_cond_wait(&pool_done, &pool_lock);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+/*
+===============================================================================
+
 GENERAL ROUTINES
 
 ===============================================================================
@@ -183,6 +303,13 @@ unsigned Sys_Milliseconds(void)
     return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000UL;
 }
 
+uint64_t Sys_Microseconds(void)
+{
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000ULL;
+}
+
 /*
 =================
 Sys_Quit
@@ -192,6 +319,7 @@ This function never returns.
 */
 void Sys_Quit(void)
 {
+    shutdown_pool();
     shutdown_work();
     tty_shutdown_input();
 #if USE_SDL
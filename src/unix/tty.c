@@ -582,11 +582,10 @@ void Sys_RunConsole(void)
         return;
     }
 
-    // make sure the next call will not block
-    tty_input->canread = false;
-
     if (ret < 0) {
         if (errno == EAGAIN || errno == EIO) {
+            // wait for more input
+            tty_input->canread = false;
             return;
         }
         tty_fatal_error("read");
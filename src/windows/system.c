@@ -945,6 +945,105 @@ void Sys_QueueAsyncWork(asyncwork_t *work)
 /*
 ===============================================================================
 
+PARALLEL WORKERS
+
+===============================================================================
+*/
+
+#define MAX_POOL_THREADS    32
+
+static bool pool_terminate;
+static HANDLE pool_sem;
+static HANDLE pool_done;
+static HANDLE pool_threads[MAX_POOL_THREADS];
+static int pool_numthreads;
+static void (*pool_func)(void *, int);
+static void *pool_arg;
+static LONG pool_count, pool_next, pool_left;
+
+static void run_pool_items(void)
+{
+    LONG index;
+
+    while ((index = InterlockedIncrement(&pool_next) - 1) < pool_count)
+        pool_func(pool_arg, index);
+}
+
+static DWORD WINAPI pool_thread_func(LPVOID arg)
+{
+    while (1) {
+        if (WaitForSingleObject(pool_sem, INFINITE))
+            return 1;
+        if (pool_terminate)
+            break;
+        run_pool_items();
+        if (!InterlockedDecrement(&pool_left))
+            SetEvent(pool_done);
+    }
+
+    return 0;
+}
+
+static void shutdown_pool(void)
+{
+    int i;
+
+    if (!pool_numthreads)
+        return;
+
+    pool_terminate = true;
+    ReleaseSemaphore(pool_sem, pool_numthreads, NULL);
+    WaitForMultipleObjects(pool_numthreads, pool_threads, TRUE, INFINITE);
+
+    for (i = 0; i < pool_numthreads; i++)
+        CloseHandle(pool_threads[i]);
+    CloseHandle(pool_sem);
+    CloseHandle(pool_done);
+    pool_numthreads = 0;
+}
+
+void Sys_ParallelFor(int numthreads, int count, void (*func)(void *, int), void *arg)
+{
+    int i;
+
+    numthreads = min(numthreads, MAX_POOL_THREADS + 1);
+    if (numthreads < 2 || count < 2) {
+        for (i = 0; i < count; i++)
+            func(arg, i);
+        return;
+    }
+
+    if (!pool_sem) {
+        pool_sem = CreateSemaphore(NULL, 0, MAX_POOL_THREADS, NULL);
+        if (!pool_sem)
+            Sys_Error("Couldn't create worker semaphore");
+        pool_done = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (!pool_done)
+            Sys_Error("Couldn't create worker event");
+    }
+
+    // calling thread does its share of work too
+    while (pool_numthreads < numthreads - 1) {
+        pool_threads[pool_numthreads] = CreateThread(NULL, 0, pool_thread_func, NULL, 0, NULL);
+        if (!pool_threads[pool_numthreads])
+            Sys_Error("Couldn't create worker thread");
+        pool_numthreads++;
+    }
+
+    pool_func = func;
+    pool_arg = arg;
+    pool_count = count;
+    pool_next = 0;
+    pool_left = numthreads - 1;
+    ReleaseSemaphore(pool_sem, numthreads - 1, NULL);
+
+    run_pool_items();
+    WaitForSingleObject(pool_done, INFINITE);
+}
+
+/*
+===============================================================================
+
 MISC
 
 ===============================================================================
@@ -1022,6 +1121,7 @@ This function never returns.
 */
 void Sys_Quit(void)
 {
+    shutdown_pool();
     shutdown_work();
 
 #if USE_CLIENT
@@ -1052,6 +1152,18 @@ unsigned Sys_Milliseconds(void)
     return tm.QuadPart * 1000ULL / timer_freq.QuadPart;
 }
 
+uint64_t Sys_Microseconds(void)
+{
+    LARGE_INTEGER tm;
+    uint64_t sec, rem;
+
+    // split to avoid overflow with high frequency counters
+    QueryPerformanceCounter(&tm);
+    sec = tm.QuadPart / timer_freq.QuadPart;
+    rem = tm.QuadPart % timer_freq.QuadPart;
+    return sec * 1000000ULL + rem * 1000000ULL / timer_freq.QuadPart;
+}
+
 void Sys_AddDefaultConfig(void)
 {
 }